@@ -0,0 +1,492 @@
+/*
+Shared 2D rasterization support for task2.c and task3.c: putPixel and its
+targets, the headless golden-image benchmark, and the retained scene with
+dirty-region redraw. Each task includes this once, after its standard
+headers and its PrimitiveShape definition.
+*/
+
+#ifndef RASTER2D_H
+#define RASTER2D_H
+
+#define CANVAS_WIDTH 800
+#define CANVAS_HEIGHT 600
+
+enum { TARGET_CANVAS, TARGET_INDEX, TARGET_BENCH }; // Where putPixel writes
+
+int renderTarget = TARGET_CANVAS;
+
+// Headless benchmark: rasterize into memory instead of the window
+#define BENCH_RUNS 10
+#define BENCH_SEEDS 3
+
+// One task's rasterizer under test
+typedef struct {
+    const char* title;
+    int primitives;                          // Primitives generated per seed
+    const unsigned long long* goldenHashes;  // FNV-1a of the reference output, per seed
+    long long (*generate)(unsigned int seed); // Builds the primitive set, returns pixels plotted
+    void (*drawReference)(void);             // Draws the set through putPixel
+    void (*drawFast)(void);                  // Optimized variant writing framebuffer directly
+} BenchSuite;
+
+unsigned char framebuffer[CANVAS_HEIGHT][CANVAS_WIDTH]; // Hit counts, so overdraw still shows every pixel
+unsigned char referencePixels[CANVAS_HEIGHT][CANVAS_WIDTH];
+const unsigned int benchSeeds[BENCH_SEEDS] = {1, 42, 2024};
+
+unsigned int nextRandom(unsigned int* seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+unsigned long long hashFramebuffer() {
+    unsigned long long hash = 1469598103934665603ULL;
+    const unsigned char* bytes = &framebuffer[0][0];
+    
+    for (size_t i = 0; i < sizeof(framebuffer); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+double elapsedSeconds(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1.0e9;
+}
+
+// Time one variant over the current primitive set; returns 0 if any pixel differs
+int benchmarkVariant(const BenchSuite* suite, const char* name, void (*draw)(void),
+                     int seedIndex, long long pixels) {
+    double times[BENCH_RUNS], mean = 0.0, variance = 0.0;
+    int passed = 1;
+    
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        struct timespec start, end;
+        memset(framebuffer, 0, sizeof(framebuffer));
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        draw();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        times[run] = elapsedSeconds(&start, &end);
+        mean += times[run] / BENCH_RUNS;
+    }
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        variance += (times[run] - mean) * (times[run] - mean) / BENCH_RUNS;
+    }
+    
+    unsigned long long hash = hashFramebuffer();
+    if (hash != suite->goldenHashes[seedIndex]) {
+        printf("  %-10s hash %016llx does not match golden %016llx\n",
+               name, hash, suite->goldenHashes[seedIndex]);
+        passed = 0;
+    }
+    for (int i = 0; i < CANVAS_WIDTH * CANVAS_HEIGHT; i++) {
+        int x = i % CANVAS_WIDTH, y = i / CANVAS_WIDTH;
+        if (framebuffer[y][x] != referencePixels[y][x]) {
+            printf("  %-10s first differing pixel at (%d,%d)\n", name, x, y);
+            passed = 0;
+            break;
+        }
+    }
+    
+    double stddev = sqrt(variance);
+    printf("  %-10s %8.2f Mpixels/s %8.2f Mprims/s  (+/- %.1f%%)  %s\n", name,
+           pixels / mean / 1.0e6, suite->primitives / mean / 1.0e6,
+           100.0 * stddev / mean, passed ? "ok" : "FAILED");
+    return passed;
+}
+
+// --bench: verify every variant against the golden images and report throughput
+int runBenchmark(const BenchSuite* suite) {
+    int passed = 1;
+    renderTarget = TARGET_BENCH;
+    
+    printf("%s, %d primitives x %d runs per seed\n", suite->title, suite->primitives, BENCH_RUNS);
+    for (int s = 0; s < BENCH_SEEDS; s++) {
+        long long pixels = suite->generate(benchSeeds[s]);
+        printf("Seed %u (%lld pixels)\n", benchSeeds[s], pixels);
+        
+        memset(framebuffer, 0, sizeof(framebuffer));
+        suite->drawReference();
+        memcpy(referencePixels, framebuffer, sizeof(framebuffer));
+        
+        passed &= benchmarkVariant(suite, "reference", suite->drawReference, s, pixels);
+        passed &= benchmarkVariant(suite, "fast", suite->drawFast, s, pixels);
+    }
+    printf("Benchmark %s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+// Retained scene: primitives are indexed by a grid of GRID_CELL square cells,
+// and only dirty rectangles of the canvas are re-rasterized. The including task
+// defines PrimitiveShape, the geometry of one primitive, before this header,
+// along with FIRST_RANDOM_PRIMITIVE (slots below it hold the task's fixed
+// example, the rest are random and editable) and SCENE_SEED.
+#define MAX_PRIMITIVES 4096
+#define GRID_CELL 32
+#define GRID_COLUMNS ((CANVAS_WIDTH + GRID_CELL - 1) / GRID_CELL)
+#define GRID_ROWS ((CANVAS_HEIGHT + GRID_CELL - 1) / GRID_CELL)
+#define MAX_CELL_ENTRIES (1 << 18)
+#define MAX_DIRTY_RECTS 16
+
+typedef struct {
+    int minX, minY, maxX, maxY; // Inclusive; empty when minX > maxX
+} Rect;
+
+typedef struct {
+    int kind;
+    int alive;
+    PrimitiveShape shape;
+    unsigned char color[3];
+    int pointSize;
+    Rect bounds; // Pixels actually covered, found by rasterizing
+} Primitive;
+
+typedef struct {
+    int primitive;
+    int next;
+} CellEntry;
+
+unsigned char canvas[CANVAS_HEIGHT][CANVAS_WIDTH][3];
+
+Primitive primitives[MAX_PRIMITIVES];
+int primitiveCount = 0; // Slots used; draw order is slot order
+int cellHeads[GRID_ROWS][GRID_COLUMNS];
+int cellStamps[GRID_ROWS][GRID_COLUMNS];
+CellEntry cellEntries[MAX_CELL_ENTRIES];
+int freeEntry = -1;
+int entriesUsed = 0;
+int currentStamp = 0;
+int primitiveVisits[MAX_PRIMITIVES];
+int gatheredPrimitives[MAX_PRIMITIVES];
+
+Rect dirtyRects[MAX_DIRTY_RECTS];
+int dirtyCount = 0;
+int frameNumber = 0;
+int animateScene = 0;
+unsigned int sceneSeed = SCENE_SEED;
+
+// State for the current putPixel pass
+Rect clipRect;
+unsigned char drawColor[3];
+int drawSize = 1;
+int indexedPrimitive;
+Rect indexBounds;
+
+// Supplied by the including task
+void rasterizePrimitive(const Primitive* primitive); // Sets drawColor/drawSize, plots via putPixel
+void translateShape(PrimitiveShape* shape, int dx, int dy);
+float shapeDistance(const Primitive* primitive, int x, int y); // From (x, y) to the drawn shape
+void addRandomPrimitive(int x, int y); // Centred near (x, y), drawn from sceneSeed
+
+void initScene() {
+    memset(cellHeads, -1, sizeof(cellHeads));
+}
+
+// Square covered by a point of drawSize pixels at (x, y), as GL draws it: odd
+// sizes are centred on the pixel, even sizes on its lower-left corner
+void pointFootprint(int x, int y, Rect* footprint) {
+    footprint->minX = x - drawSize / 2;
+    footprint->maxX = x + (drawSize - 1) / 2;
+    footprint->minY = y - drawSize / 2;
+    footprint->maxY = y + (drawSize - 1) / 2;
+}
+
+void clampRect(Rect* r, const Rect* limit) {
+    if (r->minX < limit->minX) r->minX = limit->minX;
+    if (r->minY < limit->minY) r->minY = limit->minY;
+    if (r->maxX > limit->maxX) r->maxX = limit->maxX;
+    if (r->maxY > limit->maxY) r->maxY = limit->maxY;
+}
+
+void stampPixel(int x, int y) {
+    Rect footprint;
+    pointFootprint(x, y, &footprint);
+    clampRect(&footprint, &clipRect);
+    
+    for (int py = footprint.minY; py <= footprint.maxY; py++) {
+        for (int px = footprint.minX; px <= footprint.maxX; px++) {
+            memcpy(canvas[py][px], drawColor, 3);
+        }
+    }
+}
+
+// Record the grid cells and bounds touched by the primitive being indexed
+void indexPixel(int x, int y) {
+    const Rect canvasRect = {0, 0, CANVAS_WIDTH - 1, CANVAS_HEIGHT - 1};
+    Rect footprint;
+    pointFootprint(x, y, &footprint);
+    clampRect(&footprint, &canvasRect);
+    if (footprint.minX > footprint.maxX || footprint.minY > footprint.maxY) return;
+    
+    if (footprint.minX < indexBounds.minX) indexBounds.minX = footprint.minX;
+    if (footprint.minY < indexBounds.minY) indexBounds.minY = footprint.minY;
+    if (footprint.maxX > indexBounds.maxX) indexBounds.maxX = footprint.maxX;
+    if (footprint.maxY > indexBounds.maxY) indexBounds.maxY = footprint.maxY;
+    
+    for (int cy = footprint.minY / GRID_CELL; cy <= footprint.maxY / GRID_CELL; cy++) {
+        for (int cx = footprint.minX / GRID_CELL; cx <= footprint.maxX / GRID_CELL; cx++) {
+            if (cellStamps[cy][cx] == currentStamp) continue;
+            cellStamps[cy][cx] = currentStamp;
+            
+            int entry = freeEntry;
+            if (entry >= 0) {
+                freeEntry = cellEntries[entry].next;
+            } else if (entriesUsed < MAX_CELL_ENTRIES) {
+                entry = entriesUsed++;
+            } else {
+                fprintf(stderr, "Spatial grid full; primitive %d partly unindexed\n", indexedPrimitive);
+                continue;
+            }
+            cellEntries[entry].primitive = indexedPrimitive;
+            cellEntries[entry].next = cellHeads[cy][cx];
+            cellHeads[cy][cx] = entry;
+        }
+    }
+}
+
+void putPixel(int x, int y) {
+    switch (renderTarget) {
+        case TARGET_BENCH:
+            if (x >= 0 && x < CANVAS_WIDTH && y >= 0 && y < CANVAS_HEIGHT) framebuffer[y][x]++;
+            break;
+        case TARGET_INDEX:
+            indexPixel(x, y);
+            break;
+        default:
+            stampPixel(x, y);
+            break;
+    }
+}
+
+// Merge a changed area into the dirty list, keeping it at MAX_DIRTY_RECTS
+void markDirty(Rect r) {
+    if (r.minX > r.maxX || r.minY > r.maxY) return;
+    
+    for (int merged = 1; merged; ) {
+        merged = 0;
+        for (int i = 0; i < dirtyCount; i++) {
+            Rect* d = &dirtyRects[i];
+            if (r.minX > d->maxX + 1 || r.maxX < d->minX - 1 ||
+                r.minY > d->maxY + 1 || r.maxY < d->minY - 1) continue;
+            
+            // Touching rectangles are absorbed, and the union may reach others
+            if (d->minX < r.minX) r.minX = d->minX;
+            if (d->minY < r.minY) r.minY = d->minY;
+            if (d->maxX > r.maxX) r.maxX = d->maxX;
+            if (d->maxY > r.maxY) r.maxY = d->maxY;
+            dirtyRects[i] = dirtyRects[--dirtyCount];
+            merged = 1;
+            break;
+        }
+    }
+    
+    if (dirtyCount < MAX_DIRTY_RECTS) {
+        dirtyRects[dirtyCount++] = r;
+        return;
+    }
+    
+    // List full: grow whichever rectangle gains the least area
+    int best = 0;
+    long bestGrowth = -1;
+    for (int i = 0; i < dirtyCount; i++) {
+        Rect* d = &dirtyRects[i];
+        long before = (long)(d->maxX - d->minX + 1) * (d->maxY - d->minY + 1);
+        long after = (long)((d->maxX > r.maxX ? d->maxX : r.maxX) - (d->minX < r.minX ? d->minX : r.minX) + 1) *
+                     ((d->maxY > r.maxY ? d->maxY : r.maxY) - (d->minY < r.minY ? d->minY : r.minY) + 1);
+        if (bestGrowth < 0 || after - before < bestGrowth) {
+            bestGrowth = after - before;
+            best = i;
+        }
+    }
+    r.minX = (r.minX < dirtyRects[best].minX) ? r.minX : dirtyRects[best].minX;
+    r.minY = (r.minY < dirtyRects[best].minY) ? r.minY : dirtyRects[best].minY;
+    r.maxX = (r.maxX > dirtyRects[best].maxX) ? r.maxX : dirtyRects[best].maxX;
+    r.maxY = (r.maxY > dirtyRects[best].maxY) ? r.maxY : dirtyRects[best].maxY;
+    dirtyRects[best] = dirtyRects[--dirtyCount];
+    markDirty(r);
+}
+
+// Rasterize a primitive once in index mode to find its cells and bounds
+void indexPrimitive(int id) {
+    Primitive* primitive = &primitives[id];
+    indexedPrimitive = id;
+    indexBounds.minX = indexBounds.minY = 1 << 30;
+    indexBounds.maxX = indexBounds.maxY = -1;
+    currentStamp++;
+    
+    renderTarget = TARGET_INDEX;
+    rasterizePrimitive(primitive);
+    renderTarget = TARGET_CANVAS;
+    
+    primitive->bounds = indexBounds;
+    markDirty(primitive->bounds);
+}
+
+void unindexPrimitive(int id) {
+    Rect* bounds = &primitives[id].bounds;
+    if (bounds->minX > bounds->maxX) return;
+    
+    for (int cy = bounds->minY / GRID_CELL; cy <= bounds->maxY / GRID_CELL; cy++) {
+        for (int cx = bounds->minX / GRID_CELL; cx <= bounds->maxX / GRID_CELL; cx++) {
+            int* link = &cellHeads[cy][cx];
+            while (*link >= 0) {
+                int entry = *link;
+                if (cellEntries[entry].primitive == id) {
+                    *link = cellEntries[entry].next;
+                    cellEntries[entry].next = freeEntry;
+                    freeEntry = entry;
+                } else {
+                    link = &cellEntries[entry].next;
+                }
+            }
+        }
+    }
+    markDirty(*bounds);
+}
+
+int addPrimitive(int kind, PrimitiveShape shape,
+                 unsigned char r, unsigned char g, unsigned char b, int pointSize) {
+    if (primitiveCount >= MAX_PRIMITIVES) {
+        printf("Scene full (%d primitives)\n", MAX_PRIMITIVES);
+        return -1;
+    }
+    
+    int id = primitiveCount++;
+    Primitive* primitive = &primitives[id];
+    primitive->kind = kind;
+    primitive->alive = 1;
+    primitive->shape = shape;
+    primitive->color[0] = r; primitive->color[1] = g; primitive->color[2] = b;
+    primitive->pointSize = pointSize;
+    indexPrimitive(id);
+    return id;
+}
+
+void removePrimitive(int id) {
+    unindexPrimitive(id);
+    primitives[id].alive = 0;
+}
+
+void movePrimitive(int id, int dx, int dy) {
+    unindexPrimitive(id);
+    translateShape(&primitives[id].shape, dx, dy);
+    indexPrimitive(id);
+}
+
+// Topmost live primitive drawn within a few pixels of (x, y), or -1
+int pickPrimitive(int x, int y) {
+    if (x < 0 || x >= CANVAS_WIDTH || y < 0 || y >= CANVAS_HEIGHT) return -1;
+    
+    int picked = -1;
+    for (int entry = cellHeads[y / GRID_CELL][x / GRID_CELL]; entry >= 0; entry = cellEntries[entry].next) {
+        Primitive* primitive = &primitives[cellEntries[entry].primitive];
+        if (shapeDistance(primitive, x, y) <= primitive->pointSize + 3 &&
+            cellEntries[entry].primitive > picked) {
+            picked = cellEntries[entry].primitive;
+        }
+    }
+    return picked;
+}
+
+// Copy the whole canvas to the window in one glDrawPixels
+void presentCanvas() {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glRasterPos2i(0, 0);
+    glDrawPixels(CANVAS_WIDTH, CANVAS_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, canvas);
+}
+
+int compareIds(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+// Re-rasterize only the dirty rectangles of the canvas
+void redrawDirtyRegions() {
+    long pixels = 0;
+    int redrawn = 0;
+    
+    for (int i = 0; i < dirtyCount; i++) {
+        Rect* r = &dirtyRects[i];
+        clipRect = *r;
+        for (int y = r->minY; y <= r->maxY; y++) {
+            memset(canvas[y][r->minX], 0, (r->maxX - r->minX + 1) * 3);
+        }
+        
+        // Gather each overlapping primitive once, then replay in scene order
+        int count = 0;
+        currentStamp++;
+        for (int cy = r->minY / GRID_CELL; cy <= r->maxY / GRID_CELL; cy++) {
+            for (int cx = r->minX / GRID_CELL; cx <= r->maxX / GRID_CELL; cx++) {
+                for (int entry = cellHeads[cy][cx]; entry >= 0; entry = cellEntries[entry].next) {
+                    int id = cellEntries[entry].primitive;
+                    if (primitiveVisits[id] == currentStamp) continue;
+                    primitiveVisits[id] = currentStamp;
+                    gatheredPrimitives[count++] = id;
+                }
+            }
+        }
+        qsort(gatheredPrimitives, count, sizeof(int), compareIds);
+        for (int k = 0; k < count; k++) {
+            rasterizePrimitive(&primitives[gatheredPrimitives[k]]);
+        }
+        
+        pixels += (long)(r->maxX - r->minX + 1) * (r->maxY - r->minY + 1);
+        redrawn += count;
+    }
+    
+    printf("Frame %d: %d dirty rects, %ld pixels re-rasterized (%.1f%% of canvas), %d primitives rasterized\n",
+           ++frameNumber, dirtyCount, pixels, 100.0 * pixels / (CANVAS_WIDTH * CANVAS_HEIGHT), redrawn);
+    dirtyCount = 0;
+}
+
+// Remove every random primitive, keeping the task's example
+void clearRandomPrimitives() {
+    for (int i = FIRST_RANDOM_PRIMITIVE; i < primitiveCount; i++) {
+        if (primitives[i].alive) removePrimitive(i);
+    }
+    primitiveCount = FIRST_RANDOM_PRIMITIVE;
+}
+
+// Re-rasterize the whole canvas on the next display, for comparison
+void markCanvasDirty() {
+    Rect whole = {0, 0, CANVAS_WIDTH - 1, CANVAS_HEIGHT - 1};
+    markDirty(whole);
+}
+
+// Display callback. GLUT folds window-system exposes into posted redisplays,
+// so there is no way to tell which parts of this single-buffered window lost
+// their contents. Rasterization stays limited to dirty rectangles; presenting
+// is a full copy.
+void presentScene() {
+    if (dirtyCount > 0) redrawDirtyRegions();
+    presentCanvas();
+    glFlush();
+}
+
+// Timer callback: nudge a few of the random primitives each tick
+void updateScene(int value) {
+    int randomCount = primitiveCount - FIRST_RANDOM_PRIMITIVE;
+    if (animateScene && randomCount > 0) {
+        for (int i = 0; i < 3; i++) {
+            int id = FIRST_RANDOM_PRIMITIVE + nextRandom(&sceneSeed) % randomCount;
+            if (!primitives[id].alive) continue;
+            movePrimitive(id, (int)(nextRandom(&sceneSeed) % 7) - 3, (int)(nextRandom(&sceneSeed) % 7) - 3);
+        }
+        glutPostRedisplay();
+    }
+    glutTimerFunc(33, updateScene, 0);
+}
+
+// Mouse callback: left click removes the random primitive under the cursor,
+// or adds one there
+void clickScene(int button, int state, int x, int y) {
+    if (button != GLUT_LEFT_BUTTON || state != GLUT_DOWN) return;
+    
+    int canvasY = windowHeight - 1 - y;
+    int picked = pickPrimitive(x, canvasY);
+    if (picked >= FIRST_RANDOM_PRIMITIVE) {
+        removePrimitive(picked);
+    } else if (x < CANVAS_WIDTH && canvasY >= 0 && canvasY < CANVAS_HEIGHT) {
+        addRandomPrimitive(x, canvasY);
+    }
+    glutPostRedisplay();
+}
+
+#endif
@@ -15,15 +15,27 @@ Task 2: Bresenham's Line Drawing Algorithm
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
 
 int windowWidth = 800;
 int windowHeight = 600;
 
-void putPixel(int x, int y) {
-    glBegin(GL_POINTS);
-        glVertex2i(x, y);
-    glEnd();
-}
+// Primitives per --bench seed
+#define BENCH_PRIMITIVES 20000
+
+// The example line and its two endpoint markers come first in the scene
+#define FIRST_RANDOM_PRIMITIVE 3
+#define SCENE_SEED 7
+
+enum { PRIMITIVE_LINE, PRIMITIVE_POINT };
+
+// Geometry of one retained primitive; points use x1, y1
+typedef struct {
+    int x1, y1, x2, y2;
+} PrimitiveShape;
+
+#include "raster2d.h"
 
 void bresenhamLine(int x1, int y1, int x2, int y2) {
     int dx = abs(x2 - x1);
@@ -37,10 +49,6 @@ void bresenhamLine(int x1, int y1, int x2, int y2) {
     }
     
     int p = 2 * dy - dx;
-    glColor3f(0.0, 1.0, 0.5);
-    glPointSize(3.0);
-    
-    printf("Bresenham: (%d,%d) to (%d,%d), slope=%.2f\n", x1, y1, x2, y2, (float)dy/dx);
     
     putPixel(x, y);
     
@@ -56,22 +64,121 @@ void bresenhamLine(int x1, int y1, int x2, int y2) {
     }
 }
 
-void display() {
-    glClear(GL_COLOR_BUFFER_BIT);
+// Optimized variant: same pixels as bresenhamLine, written straight to the framebuffer
+void bresenhamLineFast(int x1, int y1, int x2, int y2) {
+    int dx = abs(x2 - x1);
+    int dy = abs(y2 - y1);
+    int x, y, xEnd;
+    
+    if (x1 > x2) {
+        x = x2; y = y2; xEnd = x1;
+    } else {
+        x = x1; y = y1; xEnd = x2;
+    }
     
-    // Example with slope between 0 and 1
-    bresenhamLine(100, 150, 500, 350);
+    int yStep = (y1 < y2) ? 1 : -1;
+    int p = 2 * dy - dx;
+    int incrementE = 2 * dy;
+    int incrementNE = 2 * dy - 2 * dx;
     
-    // Mark endpoints
-    glColor3f(1.0, 0.0, 0.0);
-    glPointSize(8.0);
-    putPixel(100, 150);
-    putPixel(500, 350);
+    if ((unsigned) x < CANVAS_WIDTH && (unsigned) y < CANVAS_HEIGHT) framebuffer[y][x]++;
     
-    glFlush();
+    while (x < xEnd) {
+        x++;
+        if (p >= 0) {
+            y += yStep;
+            p += incrementNE;
+        } else {
+            p += incrementE;
+        }
+        if ((unsigned) x < CANVAS_WIDTH && (unsigned) y < CANVAS_HEIGHT) framebuffer[y][x]++;
+    }
+}
+
+// Golden FNV-1a hashes of bresenhamLine output for each benchmark seed
+const unsigned long long goldenHashes[BENCH_SEEDS] = {
+    0x8b7973789bd157f2ULL, 0x6b35e1df1da33888ULL, 0x32af60e72f53b023ULL
+};
+
+typedef struct {
+    int x1, y1, x2, y2;
+} Line;
+
+Line benchLines[BENCH_PRIMITIVES];
+
+// Lines within the algorithm's domain (left to right, |slope| <= 1), some clipped by the edges
+long long generateLines(unsigned int seed) {
+    long long pixels = 0;
+    
+    for (int i = 0; i < BENCH_PRIMITIVES; i++) {
+        Line* line = &benchLines[i];
+        int dx = nextRandom(&seed) % 400;
+        int dy = (int)(nextRandom(&seed) % (2 * dx + 1)) - dx;
+        line->x1 = (int)(nextRandom(&seed) % 900) - 50;
+        line->y1 = (int)(nextRandom(&seed) % 700) - 50;
+        line->x2 = line->x1 + dx;
+        line->y2 = line->y1 + dy;
+        pixels += dx + 1;
+    }
+    return pixels;
+}
+
+void drawLinesReference() {
+    for (int i = 0; i < BENCH_PRIMITIVES; i++) {
+        bresenhamLine(benchLines[i].x1, benchLines[i].y1, benchLines[i].x2, benchLines[i].y2);
+    }
+}
+
+void drawLinesFast() {
+    for (int i = 0; i < BENCH_PRIMITIVES; i++) {
+        bresenhamLineFast(benchLines[i].x1, benchLines[i].y1, benchLines[i].x2, benchLines[i].y2);
+    }
+}
+
+const BenchSuite benchSuite = {
+    "Task 2: Bresenham benchmark", BENCH_PRIMITIVES, goldenHashes,
+    generateLines, drawLinesReference, drawLinesFast
+};
+
+void rasterizePrimitive(const Primitive* primitive) {
+    memcpy(drawColor, primitive->color, 3);
+    drawSize = primitive->pointSize;
+    if (primitive->kind == PRIMITIVE_LINE) {
+        bresenhamLine(primitive->shape.x1, primitive->shape.y1, primitive->shape.x2, primitive->shape.y2);
+    } else {
+        putPixel(primitive->shape.x1, primitive->shape.y1);
+    }
+}
+
+void translateShape(PrimitiveShape* shape, int dx, int dy) {
+    shape->x1 += dx; shape->y1 += dy;
+    shape->x2 += dx; shape->y2 += dy;
+}
+
+// Distance to the nearest point of the segment
+float shapeDistance(const Primitive* primitive, int x, int y) {
+    const PrimitiveShape* line = &primitive->shape;
+    float dx = line->x2 - line->x1, dy = line->y2 - line->y1;
+    float lengthSquared = dx * dx + dy * dy;
+    float t = lengthSquared > 0 ? ((x - line->x1) * dx + (y - line->y1) * dy) / lengthSquared : 0;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    float ex = line->x1 + t * dx - x, ey = line->y1 + t * dy - y;
+    return sqrtf(ex * ex + ey * ey);
+}
+
+void addRandomPrimitive(int cx, int cy) {
+    int dx = 10 + nextRandom(&sceneSeed) % 120;
+    int dy = (int)(nextRandom(&sceneSeed) % (2 * dx + 1)) - dx;
+    PrimitiveShape line = {cx - dx / 2, cy - dy / 2, cx - dx / 2 + dx, cy - dy / 2 + dy};
+    addPrimitive(PRIMITIVE_LINE, line,
+                 64 + nextRandom(&sceneSeed) % 192, 64 + nextRandom(&sceneSeed) % 192,
+                 64 + nextRandom(&sceneSeed) % 192, 1);
 }
 
 void reshape(int w, int h) {
+    windowWidth = w;
+    windowHeight = h;
     glViewport(0, 0, w, h);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -82,23 +189,61 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     if (key == 27 || key == 'q' || key == 'Q') exit(0);
+    
+    switch (key) {
+        case 'n': // Add a batch of random lines
+            for (int i = 0; i < 500; i++) {
+                addRandomPrimitive(nextRandom(&sceneSeed) % CANVAS_WIDTH, nextRandom(&sceneSeed) % CANVAS_HEIGHT);
+            }
+            printf("%d primitives in scene\n", primitiveCount);
+            break;
+        case 'a': // Toggle animation of a few lines
+            animateScene = !animateScene;
+            printf("Animation %s\n", animateScene ? "enabled" : "disabled");
+            break;
+        case 'c': // Remove every random line
+            clearRandomPrimitives();
+            break;
+        case 'f': // Force a full redraw for comparison
+            markCanvasDirty();
+            break;
+    }
+    glutPostRedisplay();
 }
 
 void init() {
     glClearColor(0.0, 0.0, 0.0, 1.0);
+    initScene();
+    
+    // Example with slope between 0 and 1, with its endpoints marked
+    int x1 = 100, y1 = 150, x2 = 500, y2 = 350;
+    printf("Bresenham: (%d,%d) to (%d,%d), slope=%.2f\n", x1, y1, x2, y2,
+           (float)abs(y2 - y1)/abs(x2 - x1));
+    PrimitiveShape line = {x1, y1, x2, y2};
+    PrimitiveShape start = {x1, y1, x1, y1};
+    PrimitiveShape end = {x2, y2, x2, y2};
+    addPrimitive(PRIMITIVE_LINE, line, 0, 255, 128, 3);
+    addPrimitive(PRIMITIVE_POINT, start, 255, 0, 0, 8);
+    addPrimitive(PRIMITIVE_POINT, end, 255, 0, 0, 8);
+    
     printf("Task 2: Bresenham's Line Algorithm\nPress ESC or Q to quit\n");
+    printf("N - add 500 lines, A - animate, C - clear, F - full redraw, click - remove/add line\n");
 }
 
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return runBenchmark(&benchSuite);
+    
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
     glutInitWindowSize(windowWidth, windowHeight);
     glutCreateWindow("Task 2: Bresenham Algorithm");
     
     init();
-    glutDisplayFunc(display);
+    glutDisplayFunc(presentScene);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
+    glutMouseFunc(clickScene);
+    glutTimerFunc(33, updateScene, 0);
     glutMainLoop();
     return 0;
 }
@@ -14,16 +14,29 @@ Task 3: Midpoint Circle Drawing Algorithm
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
 
 int windowWidth = 800;
 int windowHeight = 600;
 int centerX = 400, centerY = 300, radius = 120;
 
-void putPixel(int x, int y) {
-    glBegin(GL_POINTS);
-        glVertex2i(x, y);
-    glEnd();
-}
+// Primitives per --bench seed
+#define BENCH_PRIMITIVES 5000
+
+// The example circle and its centre marker come first in the scene
+#define FIRST_RANDOM_PRIMITIVE 2
+#define SCENE_SEED 11
+
+enum { PRIMITIVE_CIRCLE, PRIMITIVE_POINT };
+
+// Geometry of one retained primitive; points use xc, yc
+typedef struct {
+    int xc, yc, r;
+} PrimitiveShape;
+
+#include "raster2d.h"
 
 void plot8Points(int xc, int yc, int x, int y) {
     putPixel(xc + x, yc + y);
@@ -40,11 +53,6 @@ void midpointCircle(int xc, int yc, int r) {
     int x = 0, y = r;
     int p = 1 - r;
     
-    glColor3f(0.0, 1.0, 0.5);
-    glPointSize(2.0);
-    
-    printf("Circle: center(%d,%d), radius=%d\n", xc, yc, r);
-    
     plot8Points(xc, yc, x, y);
     
     while (x <= y) {
@@ -59,20 +67,131 @@ void midpointCircle(int xc, int yc, int r) {
     }
 }
 
-void display() {
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    midpointCircle(centerX, centerY, radius);
+// Optimized variant: same pixels as midpointCircle, written straight to the
+// framebuffer and skipping the bounds checks when the circle is fully inside
+void midpointCircleFast(int xc, int yc, int r) {
+    int x = 0, y = r;
+    int p = 1 - r;
+    int inside = (xc - r >= 0 && xc + r < CANVAS_WIDTH && yc - r >= 0 && yc + r < CANVAS_HEIGHT);
     
-    // Mark center
-    glColor3f(1.0, 0.0, 0.0);
-    glPointSize(8.0);
-    putPixel(centerX, centerY);
+    for (;;) {
+        if (inside) {
+            framebuffer[yc + y][xc + x]++;
+            framebuffer[yc + y][xc - x]++;
+            framebuffer[yc - y][xc + x]++;
+            framebuffer[yc - y][xc - x]++;
+            framebuffer[yc + x][xc + y]++;
+            framebuffer[yc + x][xc - y]++;
+            framebuffer[yc - x][xc + y]++;
+            framebuffer[yc - x][xc - y]++;
+        } else {
+            int px[8] = {xc + x, xc - x, xc + x, xc - x, xc + y, xc - y, xc + y, xc - y};
+            int py[8] = {yc + y, yc + y, yc - y, yc - y, yc + x, yc + x, yc - x, yc - x};
+            for (int k = 0; k < 8; k++) {
+                if ((unsigned) px[k] < CANVAS_WIDTH && (unsigned) py[k] < CANVAS_HEIGHT) framebuffer[py[k]][px[k]]++;
+            }
+        }
+        
+        if (x > y) break;
+        x++;
+        if (p < 0) {
+            p += 2 * x + 1;
+        } else {
+            y--;
+            p += 2 * (x - y) + 1;
+        }
+    }
+}
+
+// Golden FNV-1a hashes of midpointCircle output for each benchmark seed
+const unsigned long long goldenHashes[BENCH_SEEDS] = {
+    0xeafce046f1621fa6ULL, 0xef0995c8adeb7186ULL, 0xb44fa9b3a1c18ecfULL
+};
+
+typedef struct {
+    int xc, yc, r;
+} Circle;
+
+Circle benchCircles[BENCH_PRIMITIVES];
+
+// Circles of radius 1-150, some clipped by the edges
+long long generateCircles(unsigned int seed) {
+    long long pixels = 0;
     
-    glFlush();
+    for (int i = 0; i < BENCH_PRIMITIVES; i++) {
+        Circle* circle = &benchCircles[i];
+        circle->xc = (int)(nextRandom(&seed) % 900) - 50;
+        circle->yc = (int)(nextRandom(&seed) % 700) - 50;
+        circle->r = 1 + nextRandom(&seed) % 150;
+        
+        // Count plot8Points calls by replaying the decision variable
+        int x = 0, y = circle->r, p = 1 - circle->r;
+        pixels += 8;
+        while (x <= y) {
+            x++;
+            if (p < 0) {
+                p = p + 2 * x + 1;
+            } else {
+                y--;
+                p = p + 2 * x - 2 * y + 1;
+            }
+            pixels += 8;
+        }
+    }
+    return pixels;
+}
+
+void drawCirclesReference() {
+    for (int i = 0; i < BENCH_PRIMITIVES; i++) {
+        midpointCircle(benchCircles[i].xc, benchCircles[i].yc, benchCircles[i].r);
+    }
+}
+
+void drawCirclesFast() {
+    for (int i = 0; i < BENCH_PRIMITIVES; i++) {
+        midpointCircleFast(benchCircles[i].xc, benchCircles[i].yc, benchCircles[i].r);
+    }
+}
+
+const BenchSuite benchSuite = {
+    "Task 3: Midpoint circle benchmark", BENCH_PRIMITIVES, goldenHashes,
+    generateCircles, drawCirclesReference, drawCirclesFast
+};
+
+void rasterizePrimitive(const Primitive* primitive) {
+    memcpy(drawColor, primitive->color, 3);
+    drawSize = primitive->pointSize;
+    if (primitive->kind == PRIMITIVE_CIRCLE) {
+        midpointCircle(primitive->shape.xc, primitive->shape.yc, primitive->shape.r);
+    } else {
+        putPixel(primitive->shape.xc, primitive->shape.yc);
+    }
+}
+
+void translateShape(PrimitiveShape* shape, int dx, int dy) {
+    shape->xc += dx;
+    shape->yc += dy;
+}
+
+// Distance to the centre for points, to the outline for circles
+float shapeDistance(const Primitive* primitive, int x, int y) {
+    const PrimitiveShape* circle = &primitive->shape;
+    float distance = sqrtf((float)((x - circle->xc) * (x - circle->xc) +
+                                   (y - circle->yc) * (y - circle->yc)));
+    if (primitive->kind == PRIMITIVE_CIRCLE) distance = fabsf(distance - circle->r);
+    return distance;
+}
+
+void addRandomPrimitive(int cx, int cy) {
+    PrimitiveShape circle = {cx, cy, 5 + nextRandom(&sceneSeed) % 60};
+    addPrimitive(PRIMITIVE_CIRCLE, circle,
+                 64 + nextRandom(&sceneSeed) % 192, 64 + nextRandom(&sceneSeed) % 192,
+                 64 + nextRandom(&sceneSeed) % 192, 1);
 }
 
 void reshape(int w, int h) {
+    windowWidth = w;
+    windowHeight = h;
     glViewport(0, 0, w, h);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -83,23 +202,57 @@ void reshape(int w, int h) {
 
 void keyboard(unsigned char key, int x, int y) {
     if (key == 27 || key == 'q' || key == 'Q') exit(0);
+    
+    switch (key) {
+        case 'n': // Add a batch of random circles
+            for (int i = 0; i < 500; i++) {
+                addRandomPrimitive(nextRandom(&sceneSeed) % CANVAS_WIDTH, nextRandom(&sceneSeed) % CANVAS_HEIGHT);
+            }
+            printf("%d primitives in scene\n", primitiveCount);
+            break;
+        case 'a': // Toggle animation of a few circles
+            animateScene = !animateScene;
+            printf("Animation %s\n", animateScene ? "enabled" : "disabled");
+            break;
+        case 'c': // Remove every random circle
+            clearRandomPrimitives();
+            break;
+        case 'f': // Force a full redraw for comparison
+            markCanvasDirty();
+            break;
+    }
+    glutPostRedisplay();
 }
 
 void init() {
     glClearColor(0.0, 0.0, 0.0, 1.0);
+    initScene();
+    
+    // Example circle with its center marked
+    printf("Circle: center(%d,%d), radius=%d\n", centerX, centerY, radius);
+    PrimitiveShape circle = {centerX, centerY, radius};
+    PrimitiveShape center = {centerX, centerY, 0};
+    addPrimitive(PRIMITIVE_CIRCLE, circle, 0, 255, 128, 2);
+    addPrimitive(PRIMITIVE_POINT, center, 255, 0, 0, 8);
+    
     printf("Task 3: Midpoint Circle Algorithm\nPress ESC or Q to quit\n");
+    printf("N - add 500 circles, A - animate, C - clear, F - full redraw, click - remove/add circle\n");
 }
 
 int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return runBenchmark(&benchSuite);
+    
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
     glutInitWindowSize(windowWidth, windowHeight);
     glutCreateWindow("Task 3: Midpoint Circle");
     
     init();
-    glutDisplayFunc(display);
+    glutDisplayFunc(presentScene);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
+    glutMouseFunc(clickScene);
+    glutTimerFunc(33, updateScene, 0);
     glutMainLoop();
     return 0;
 }
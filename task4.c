@@ -5,9 +5,11 @@
 
 #ifdef __APPLE__
 #include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
 #include <OpenGL/glu.h>
 #include <GLUT/glut.h>
 #else
+#define GL_GLEXT_PROTOTYPES
 #include <GL/glut.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
@@ -16,6 +18,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
 
 // Window dimensions
 int windowWidth = 1024;
@@ -34,13 +41,169 @@ float cameraAngleX = 0.0f;
 float cameraAngleY = 0.0f;
 
 // Texture variables
-GLuint textureID;
+#ifndef TEXTURE_SIZE
+#define TEXTURE_SIZE 128
+#endif
+#define TEXTURE_BYTES (TEXTURE_SIZE * TEXTURE_SIZE * 3)
+#define TEXTURE_COUNT 5
+GLuint textureID;     // Texture currently drawn
+GLuint backTextureID; // Texture receiving the next upload
 int currentTexture = 0; // 0=checkerboard, 1=gradient, 2=grid, 3=plasma, 4=wood
 
+// Texture streaming variables
+#define PBO_RING_SIZE 3   // Pixel buffers the worker generates into while mapped
+#define TEXEL_POOL_SIZE 2 // CPU blocks for the first texture and unmappable buffers
+
+enum { TEXEL_FREE, TEXEL_MAPPED, TEXEL_BUSY, TEXEL_READY };
+
+typedef struct {
+    GLuint pixelBuffer;
+    GLubyte* data;              // Mapped PBO storage, or a pool block if mapping failed
+    int mapped;
+    int state;
+    int pattern;
+    unsigned int sequence;      // Orders ready buffers so only the newest is uploaded
+    unsigned long uploadFrame;  // Poll that last sourced an upload from this buffer
+} TexelBuffer;
+
+TexelBuffer texelRing[PBO_RING_SIZE];
+unsigned long streamFrame = 0;
+int pendingSwap = -1;       // Pattern uploaded to the back texture, shown next frame
+
+pthread_t streamThread;
+pthread_mutex_t streamMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t streamCond = PTHREAD_COND_INITIALIZER;
+int streamRunning = 0;
+int requestedTexture = -1;  // Pattern waiting for the worker, -1 if none
+unsigned int streamSequence = 0;
+
 // Rendering modes
 int wireframeMode = 0;
 int lightingEnabled = 1;
 int showMultipleCubes = 0;
+int cubeGridRadius = 1;    // Multiple cubes mode draws a (2r+1) x (2r+1) grid
+#define MAX_GRID_RADIUS 10
+
+// Memory management variables
+#define FRAME_ARENA_SIZE (256 * 1024)
+#define ARENA_ALIGNMENT 16
+#define MEMCHECK_WARMUP_FRAMES 10
+
+// Linear allocator for data that lives for one frame only
+typedef struct {
+    unsigned char* base;
+    size_t capacity;
+    size_t used;
+    size_t highWater;
+    int overflows;
+} FrameArena;
+
+// Fixed-size block allocator; free blocks are chained through their first word
+typedef struct {
+    unsigned char* base;
+    size_t blockSize;
+    int blockCount;
+    void* freeList;
+    int inUse;
+    int highWater;
+} BlockPool;
+
+FrameArena frameArena;
+BlockPool texelBlockPool;
+atomic_ulong heapAllocations = 0; // Every heap allocation in the process, see malloc below
+unsigned long frameCount = 0;
+int memoryViolations = 0;
+unsigned long uploadAllocations = 0; // Driver allocations during texture switches
+unsigned long modeAllocations = 0;   // Driver allocations on the first frame of a new mode
+int lastRenderMode = -1;             // Lighting path drawn by the previous frame
+int memcheckFrames = 0;            // Non-zero runs the --memcheck self test
+
+// Per-frame cube instance, built in the frame arena
+typedef struct {
+    float x, y, z;
+    float angleX, angleY;
+    float r, g, b;
+    float depth; // Distance along the view direction, used for sorting
+    int lod;
+} CubeInstance;
+
+// Level-of-detail cube meshes
+#define LOD_LEVELS 4
+#define LOD_TARGET_PIXELS 16.0f // Largest on-screen quad edge before refining
+#define FIELD_OF_VIEW 45.0f
+
+// Vertex layout matching GL_T2F_N3F_V3F
+typedef struct {
+    float s, t;
+    float nx, ny, nz;
+    float x, y, z;
+} MeshVertex;
+
+typedef struct {
+    int subdivisions; // Quads per face edge on the flat cube
+    int segments;     // Quads per face edge as built, including fillet rows
+    MeshVertex* vertices;
+    GLushort* indices;
+    int indexCount;
+} CubeMesh;
+
+// Per face: corner at texcoord (0,0), edge along s, edge along t, outward normal
+const float cubeFaces[6][12] = {
+    {-1, -1,  1,   2, 0,  0,   0, 2,  0,   0,  0,  1}, // Front
+    { 1, -1, -1,  -2, 0,  0,   0, 2,  0,   0,  0, -1}, // Back
+    {-1,  1,  1,   2, 0,  0,   0, 0, -2,   0,  1,  0}, // Top
+    { 1, -1,  1,  -2, 0,  0,   0, 0, -2,   0, -1,  0}, // Bottom
+    { 1, -1,  1,   0, 0, -2,   0, 2,  0,   1,  0,  0}, // Right
+    {-1, -1, -1,   0, 0,  2,   0, 2,  0,  -1,  0,  0}  // Left
+};
+
+const int lodSubdivisions[LOD_LEVELS] = {1, 4, 12, 32};
+CubeMesh cubeMeshes[LOD_LEVELS];
+int lodMode = -1;            // -1 picks by screen size, otherwise a fixed level
+float cubeRoundness = 0.0f;  // Edge radius as a fraction of the half size
+
+// Recording variables
+#define RECORD_SLOTS 8      // Pixel buffers shared by the render and encoder threads
+#define RECORD_QUEUE_CAPACITY (RECORD_SLOTS + 1)
+
+// Lock-free single-producer single-consumer ring of frame slot indices
+typedef struct {
+    int items[RECORD_QUEUE_CAPACITY];
+    atomic_int head; // Advanced by the consumer
+    atomic_int tail; // Advanced by the producer
+} FrameQueue;
+
+int recording = 0;
+const char* recordPath = "capture.y4m";
+const char* recordPipe = NULL;  // Encoder command fed Y4M on stdin, if set
+int recordFrameLimit = 0;       // Non-zero stops and exits after this many frames
+int recordOnStart = 0;          // Set by --record; starts once the window is up
+FILE* recordFile = NULL;
+int recordY4M = 1;              // Y4M 4:2:0, otherwise raw RGB24 frames
+int recordWidth, recordHeight;
+size_t recordFrameBytes;
+unsigned char* recordPlanes = NULL; // Encoder-owned output frame
+GLuint recordPixelBuffers[RECORD_SLOTS];
+const unsigned char* recordMapped[RECORD_SLOTS]; // Mapped BGRA frame per queued slot
+int idleSlots[RECORD_SLOTS];     // Unmapped buffers ready for a readback
+int idleSlotCount = 0;
+int pendingSlot = -1;            // Buffer whose readback was issued last frame
+unsigned long recordFrameIndex = 0;
+
+FrameQueue filledFrames; // Render thread -> encoder, mapped frames
+FrameQueue freeFrames;   // Encoder -> render thread, done but still mapped
+pthread_t encoderThread;
+atomic_int encoderRunning;
+pthread_mutex_t encoderMutex = PTHREAD_MUTEX_INITIALIZER; // Guards only the encoder's sleep
+pthread_cond_t encoderWake = PTHREAD_COND_INITIALIZER;
+
+// Backpressure statistics
+unsigned long framesCaptured = 0;
+unsigned long framesDropped = 0;
+unsigned long framesEncoded = 0;
+int queueHighWater = 0;
+double captureMilliseconds = 0.0; // Render-thread cost
+double encodeMilliseconds = 0.0;  // Encoder-thread cost
 
 // Lighting variables
 float lightPosition[4] = {2.0f, 2.0f, 2.0f, 1.0f};
@@ -49,13 +212,232 @@ float lightDiffuse[4] = {1.0f, 1.0f, 1.0f, 1.0f};
 float lightSpecular[4] = {1.0f, 1.0f, 1.0f, 1.0f};
 
 // Material properties
+float materialSpecular[4] = {0.6f, 0.6f, 0.6f, 1.0f};
 float materialShininess = 50.0f;
 
+// Clustered lighting variables
+#define MAX_POINT_LIGHTS 1024
+#define CLUSTER_X 16          // Screen-space tiles across
+#define CLUSTER_Y 9           // Screen-space tiles down
+#define CLUSTER_Z 24          // Exponential depth slices
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 64
+#define CLUSTER_BUFFER_FRAMES 3 // Frames of cluster data in flight; swaps keep fewer queued
+#define CLUSTER_THREADS 4     // Binning threads, including the GLUT thread
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 100.0f
+
+// Point lights stored as structure-of-arrays so per-light loops stay linear
+typedef struct {
+    int count;
+    float baseX[MAX_POINT_LIGHTS], baseY[MAX_POINT_LIGHTS], baseZ[MAX_POINT_LIGHTS];
+    float eyeX[MAX_POINT_LIGHTS], eyeY[MAX_POINT_LIGHTS], eyeZ[MAX_POINT_LIGHTS];
+    float radius[MAX_POINT_LIGHTS];
+    float red[MAX_POINT_LIGHTS], green[MAX_POINT_LIGHTS], blue[MAX_POINT_LIGHTS];
+    int minSlice[MAX_POINT_LIGHTS], maxSlice[MAX_POINT_LIGHTS];
+} PointLights;
+
+PointLights pointLights;
+float lightOrbitAngle = 0.0f;
+int clusteredLighting = 0;
+int clusterOverflows = 0;  // Light references dropped from full clusters last frame
+
+// Clusters are numbered (slice * CLUSTER_Y + tileY) * CLUSTER_X + tileX.
+// Threads bin into fixed per-cluster slots, which are then packed into one
+// compact index list so the shader only reads references actually binned.
+int clusterCounts[CLUSTER_COUNT];
+unsigned short clusterSlots[CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER];
+int clusterReferences = 0;
+
+// What the cluster shader reads, each through its own buffer texture
+enum { STREAM_LIGHT_DATA, STREAM_RANGES, STREAM_INDICES, CLUSTER_STREAMS };
+
+// A persistently mapped buffer: the CPU writes straight into memory the
+// shader samples, so a frame never uploads (and never enters the driver's
+// allocator). Each frame in flight has its own copy.
+typedef struct {
+    GLuint buffer;
+    GLuint texture;
+    void* data;
+} ClusterStream;
+
+ClusterStream clusterStreams[CLUSTER_BUFFER_FRAMES][CLUSTER_STREAMS];
+int clusterFrame = 0;
+
+GLuint clusterProgram = 0;
+GLint viewportSizeUniform, shininessUniform;
+
+pthread_t clusterThreads[CLUSTER_THREADS];
+pthread_mutex_t clusterMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t clusterStart = PTHREAD_COND_INITIALIZER;
+pthread_cond_t clusterDone = PTHREAD_COND_INITIALIZER;
+int clusterGeneration = 0;
+int clusterPending = 0;
+int clusterActiveThreads = CLUSTER_THREADS;
+int clusterOverflowCounts[CLUSTER_THREADS];
+int clusterWorkersStarted = 0;
+float clusterFocalX, clusterFocalY; // Projection scale captured for the binning pass
+
+#ifdef __GLIBC__
+// Interpose every glibc allocation entry point so the steady-state check also
+// sees allocations made by libc (qsort, stdio) and the GL driver, not just our
+// own heapAlloc calls
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* memory, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void* __libc_valloc(size_t size);
+extern void* __libc_pvalloc(size_t size);
+
+void* malloc(size_t size) {
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* memory, size_t size) {
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    return __libc_realloc(memory, size);
+}
+
+int posix_memalign(void** memory, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    *memory = __libc_memalign(alignment, size);
+    return *memory ? 0 : ENOMEM;
+}
+
+void* memalign(size_t alignment, size_t size) {
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void* valloc(size_t size) {
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size) {
+    atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+    return __libc_pvalloc(size);
+}
+
+// glibc's own reallocarray bypasses realloc above, so route it through
+void* reallocarray(void* memory, size_t count, size_t size) {
+    if (size && count > (size_t) -1 / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(memory, count * size);
+}
+#endif
+
+// The program's own heap entry point; called at startup and when a recording starts, never per frame
+void* heapAlloc(size_t size) {
+    void* memory = malloc(size);
+    if (!memory) {
+        fprintf(stderr, "Out of memory allocating %lu bytes\n", (unsigned long) size);
+        exit(1);
+    }
+#ifndef __GLIBC__
+    heapAllocations++;
+#endif
+    return memory;
+}
+
+// Releases memory obtained from heapAlloc, e.g. the recording planes when a recording stops
+void heapFree(void* memory) {
+    free(memory);
+}
+
+void arenaInit(FrameArena* arena, size_t capacity) {
+    arena->base = (unsigned char*) heapAlloc(capacity);
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->highWater = 0;
+    arena->overflows = 0;
+}
+
+void arenaReset(FrameArena* arena) {
+    arena->used = 0;
+}
+
+// Returns NULL (and counts an overflow) instead of growing
+void* arenaAlloc(FrameArena* arena, size_t size) {
+    size_t offset = (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (offset + size > arena->capacity) {
+        arena->overflows++;
+        return NULL;
+    }
+    arena->used = offset + size;
+    if (arena->used > arena->highWater) arena->highWater = arena->used;
+    return arena->base + offset;
+}
+
+void poolInit(BlockPool* pool, size_t blockSize, int blockCount) {
+    pool->blockSize = (blockSize + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    pool->blockCount = blockCount;
+    pool->base = (unsigned char*) heapAlloc(pool->blockSize * blockCount);
+    pool->freeList = NULL;
+    pool->inUse = 0;
+    pool->highWater = 0;
+    
+    for (int i = blockCount - 1; i >= 0; i--) {
+        void** block = (void**) (pool->base + i * pool->blockSize);
+        *block = pool->freeList;
+        pool->freeList = block;
+    }
+}
+
+// Not thread safe; callers sharing a pool must lock around it
+void* poolAlloc(BlockPool* pool) {
+    void** block = (void**) pool->freeList;
+    if (!block) return NULL;
+    
+    pool->freeList = *block;
+    pool->inUse++;
+    if (pool->inUse > pool->highWater) pool->highWater = pool->inUse;
+    return block;
+}
+
+void poolFree(BlockPool* pool, void* memory) {
+    if (!memory) return;
+    
+    *(void**) memory = pool->freeList;
+    pool->freeList = memory;
+    pool->inUse--;
+}
+
+// Print high-water marks for every allocator
+void printMemoryReport() {
+    printf("\n=== Memory Report ===\n");
+    printf("Frame arena: %lu / %lu bytes high-water, %d overflows\n",
+           (unsigned long) frameArena.highWater, (unsigned long) frameArena.capacity,
+           frameArena.overflows);
+    pthread_mutex_lock(&streamMutex);
+    printf("Texel pool: %d / %d blocks high-water (%lu bytes each)\n",
+           texelBlockPool.highWater, texelBlockPool.blockCount,
+           (unsigned long) texelBlockPool.blockSize);
+    pthread_mutex_unlock(&streamMutex);
+    printf("Heap allocations: %lu total, %lu in texture uploads, %lu in mode changes, "
+           "%d steady-state violations in %lu frames\n",
+           (unsigned long) heapAllocations, uploadAllocations, modeAllocations, memoryViolations, frameCount);
+    printf("=====================\n\n");
+}
+
 // Create different texture patterns
-void createCheckerboardTexture() {
-    const int texWidth = 128;
-    const int texHeight = 128;
-    GLubyte textureData[texWidth][texHeight][3];
+void createCheckerboardTexture(GLubyte (*textureData)[TEXTURE_SIZE][3]) {
+    const int texWidth = TEXTURE_SIZE;
+    const int texHeight = TEXTURE_SIZE;
     
     printf("Creating enhanced checkerboard texture...\n");
     
@@ -67,15 +449,11 @@ void createCheckerboardTexture() {
             textureData[i][j][2] = (GLubyte) checker;
         }
     }
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 
-                 0, GL_RGB, GL_UNSIGNED_BYTE, textureData);
 }
 
-void createGradientTexture() {
-    const int texWidth = 128;
-    const int texHeight = 128;
-    GLubyte textureData[texWidth][texHeight][3];
+void createGradientTexture(GLubyte (*textureData)[TEXTURE_SIZE][3]) {
+    const int texWidth = TEXTURE_SIZE;
+    const int texHeight = TEXTURE_SIZE;
     
     printf("Creating rainbow gradient texture...\n");
     
@@ -89,15 +467,11 @@ void createGradientTexture() {
             textureData[i][j][2] = (GLubyte) (255 * (0.5f + 0.5f * sin((u + v) * 3.14f)));
         }
     }
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 
-                 0, GL_RGB, GL_UNSIGNED_BYTE, textureData);
 }
 
-void createGridTexture() {
-    const int texWidth = 128;
-    const int texHeight = 128;
-    GLubyte textureData[texWidth][texHeight][3];
+void createGridTexture(GLubyte (*textureData)[TEXTURE_SIZE][3]) {
+    const int texWidth = TEXTURE_SIZE;
+    const int texHeight = TEXTURE_SIZE;
     
     printf("Creating enhanced grid texture...\n");
     
@@ -121,15 +495,11 @@ void createGridTexture() {
             }
         }
     }
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 
-                 0, GL_RGB, GL_UNSIGNED_BYTE, textureData);
 }
 
-void createPlasmaTexture() {
-    const int texWidth = 128;
-    const int texHeight = 128;
-    GLubyte textureData[texWidth][texHeight][3];
+void createPlasmaTexture(GLubyte (*textureData)[TEXTURE_SIZE][3]) {
+    const int texWidth = TEXTURE_SIZE;
+    const int texHeight = TEXTURE_SIZE;
     
     printf("Creating plasma texture...\n");
     
@@ -147,15 +517,11 @@ void createPlasmaTexture() {
             textureData[i][j][2] = (GLubyte) (255 * fabs(sin(plasma * 3.14159f)));
         }
     }
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 
-                 0, GL_RGB, GL_UNSIGNED_BYTE, textureData);
 }
 
-void createWoodTexture() {
-    const int texWidth = 128;
-    const int texHeight = 128;
-    GLubyte textureData[texWidth][texHeight][3];
+void createWoodTexture(GLubyte (*textureData)[TEXTURE_SIZE][3]) {
+    const int texWidth = TEXTURE_SIZE;
+    const int texHeight = TEXTURE_SIZE;
     
     printf("Creating wood texture...\n");
     
@@ -172,57 +538,263 @@ void createWoodTexture() {
             textureData[i][j][2] = (GLubyte) (19 * wood);
         }
     }
+}
+
+// Texture generators indexed by currentTexture
+typedef void (*TextureGenerator)(GLubyte (*textureData)[TEXTURE_SIZE][3]);
+
+TextureGenerator textureGenerators[TEXTURE_COUNT] = {
+    createCheckerboardTexture,
+    createGradientTexture,
+    createGridTexture,
+    createPlasmaTexture,
+    createWoodTexture
+};
+
+const char* textureNames[TEXTURE_COUNT] = {
+    "enhanced checkerboard", "rainbow gradient", "enhanced grid", "plasma", "wood"
+};
+
+// Pick a buffer for the worker: a mapped idle one, else the oldest stale ready one.
+// Caller must hold streamMutex.
+TexelBuffer* acquireTexelBuffer() {
+    TexelBuffer* oldestReady = NULL;
+    
+    for (int i = 0; i < PBO_RING_SIZE; i++) {
+        if (texelRing[i].state == TEXEL_MAPPED) return &texelRing[i];
+        if (texelRing[i].state == TEXEL_READY &&
+            (!oldestReady || texelRing[i].sequence < oldestReady->sequence)) {
+            oldestReady = &texelRing[i];
+        }
+    }
+    return oldestReady;
+}
+
+// Worker thread: generates requested patterns straight into mapped pixel buffers
+void* textureStreamWorker(void* arg) {
+    pthread_mutex_lock(&streamMutex);
+    while (streamRunning) {
+        TexelBuffer* buffer = (requestedTexture >= 0) ? acquireTexelBuffer() : NULL;
+        if (!buffer) {
+            pthread_cond_wait(&streamCond, &streamMutex);
+            continue;
+        }
+        
+        int pattern = requestedTexture;
+        requestedTexture = -1;
+        buffer->state = TEXEL_BUSY;
+        pthread_mutex_unlock(&streamMutex);
+        
+        textureGenerators[pattern]((GLubyte (*)[TEXTURE_SIZE][3]) buffer->data);
+        
+        pthread_mutex_lock(&streamMutex);
+        buffer->pattern = pattern;
+        buffer->sequence = ++streamSequence;
+        buffer->state = TEXEL_READY;
+    }
+    pthread_mutex_unlock(&streamMutex);
+    return NULL;
+}
+
+// Map every free ring buffer whose last upload has had time to finish, so the
+// worker always has somewhere to write. Falls back to a pool block if mapping fails.
+// Returns whether any buffer was mapped, which may allocate inside the driver
+int mapTexelBuffers() {
+    int mappedAny = 0;
+    
+    for (int i = 0; i < PBO_RING_SIZE; i++) {
+        TexelBuffer* buffer = &texelRing[i];
+        if (buffer->state != TEXEL_FREE) continue;
+        if (streamFrame - buffer->uploadFrame < PBO_RING_SIZE - 1) continue;
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->pixelBuffer);
+        buffer->data = (GLubyte*) glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        buffer->mapped = (buffer->data != NULL);
+        
+        pthread_mutex_lock(&streamMutex);
+        if (!buffer->mapped) buffer->data = (GLubyte*) poolAlloc(&texelBlockPool);
+        if (buffer->data) {
+            buffer->state = TEXEL_MAPPED;
+            mappedAny = 1;
+        }
+        pthread_mutex_unlock(&streamMutex);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 
-                 0, GL_RGB, GL_UNSIGNED_BYTE, textureData);
+    if (mappedAny) {
+        pthread_mutex_lock(&streamMutex);
+        pthread_cond_signal(&streamCond);
+        pthread_mutex_unlock(&streamMutex);
+    }
+    return mappedAny;
+}
+
+// Give a buffer's storage back: unmap it, or return its pool block
+void unmapTexelBuffer(TexelBuffer* buffer) {
+    if (buffer->mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->pixelBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        pthread_mutex_lock(&streamMutex);
+        poolFree(&texelBlockPool, buffer->data);
+        pthread_mutex_unlock(&streamMutex);
+    }
+    buffer->data = NULL;
+    buffer->mapped = 0;
 }
 
 // Initialize texture
 void initTexture() {
-    glGenTextures(1, &textureID);
+    GLuint textures[2];
+    glGenTextures(2, textures);
+    textureID = textures[0];
+    backTextureID = textures[1];
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        
+        // Set texture parameters
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        
+        // Allocate storage once; streamed uploads only replace the texels
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, TEXTURE_SIZE, TEXTURE_SIZE,
+                     0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    }
+    
+    poolInit(&texelBlockPool, TEXTURE_BYTES, TEXEL_POOL_SIZE);
+    
+    // Create initial texture synchronously so the first frame is textured
+    GLubyte* initialTexels = (GLubyte*) poolAlloc(&texelBlockPool);
+    createCheckerboardTexture((GLubyte (*)[TEXTURE_SIZE][3]) initialTexels);
     glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TEXTURE_SIZE, TEXTURE_SIZE,
+                    GL_RGB, GL_UNSIGNED_BYTE, initialTexels);
+    poolFree(&texelBlockPool, initialTexels);
+    
+    // Ring storage is allocated once and reused; it is never orphaned
+    for (int i = 0; i < PBO_RING_SIZE; i++) {
+        glGenBuffers(1, &texelRing[i].pixelBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texelRing[i].pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, TEXTURE_BYTES, NULL, GL_STREAM_DRAW);
+        texelRing[i].data = NULL;
+        texelRing[i].mapped = 0;
+        texelRing[i].state = TEXEL_FREE;
+        texelRing[i].uploadFrame = 0;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    streamFrame = PBO_RING_SIZE;
     
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    streamRunning = 1;
+    if (pthread_create(&streamThread, NULL, textureStreamWorker, NULL) != 0) {
+        fprintf(stderr, "Failed to start texture streaming thread\n");
+        exit(1);
+    }
+    mapTexelBuffers();
+    printf("Enhanced texture system initialized with ID: %d (%dx%d, streamed)\n",
+           textureID, TEXTURE_SIZE, TEXTURE_SIZE);
+}
+
+// Stop the streaming worker and release the ring before exit
+void shutdownTexture() {
+    if (!streamRunning) return;
+    
+    pthread_mutex_lock(&streamMutex);
+    streamRunning = 0;
+    pthread_cond_broadcast(&streamCond);
+    pthread_mutex_unlock(&streamMutex);
+    pthread_join(streamThread, NULL);
     
-    // Create initial texture
-    createCheckerboardTexture();
-    printf("Enhanced texture system initialized with ID: %d\n", textureID);
+    for (int i = 0; i < PBO_RING_SIZE; i++) {
+        if (texelRing[i].data) unmapTexelBuffer(&texelRing[i]);
+        texelRing[i].state = TEXEL_FREE;
+        glDeleteBuffers(1, &texelRing[i].pixelBuffer);
+    }
 }
 
-// Switch texture based on current selection
+// Switch texture based on current selection; generation happens on the worker
 void switchTexture() {
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (currentTexture < 0 || currentTexture >= TEXTURE_COUNT) currentTexture = 0;
     
-    switch(currentTexture) {
-        case 0:
-            createCheckerboardTexture();
-            printf("Switched to enhanced checkerboard texture\n");
-            break;
-        case 1:
-            createGradientTexture();
-            printf("Switched to rainbow gradient texture\n");
-            break;
-        case 2:
-            createGridTexture();
-            printf("Switched to enhanced grid texture\n");
-            break;
-        case 3:
-            createPlasmaTexture();
-            printf("Switched to plasma texture\n");
-            break;
-        case 4:
-            createWoodTexture();
-            printf("Switched to wood texture\n");
-            break;
-        default:
-            currentTexture = 0;
-            createCheckerboardTexture();
-            break;
+    pthread_mutex_lock(&streamMutex);
+    requestedTexture = currentTexture;
+    pthread_cond_signal(&streamCond);
+    pthread_mutex_unlock(&streamMutex);
+}
+
+// Called once per frame: show last frame's upload and start the next one.
+// The worker already wrote the texels into the buffer, so this only unmaps.
+// Returns whether this frame uploaded or remapped a texel buffer
+int pollTextureStream() {
+    streamFrame++;
+    
+    // The previous upload has had a full frame to land, so present it
+    if (pendingSwap >= 0) {
+        GLuint shown = textureID;
+        textureID = backTextureID;
+        backTextureID = shown;
+        printf("Switched to %s texture\n", textureNames[pendingSwap]);
+        pendingSwap = -1;
     }
+    
+    // Take the newest finished buffer; older ones stay mapped for reuse
+    TexelBuffer* ready = NULL;
+    pthread_mutex_lock(&streamMutex);
+    for (int i = 0; i < PBO_RING_SIZE; i++) {
+        if (texelRing[i].state != TEXEL_READY) continue;
+        if (!ready || texelRing[i].sequence > ready->sequence) {
+            if (ready) ready->state = TEXEL_MAPPED;
+            ready = &texelRing[i];
+        } else {
+            texelRing[i].state = TEXEL_MAPPED;
+        }
+    }
+    if (ready) ready->state = TEXEL_BUSY;
+    pthread_mutex_unlock(&streamMutex);
+    
+    if (ready) {
+        glBindTexture(GL_TEXTURE_2D, backTextureID);
+        if (ready->mapped) {
+            // Source offset 0 in the bound PBO, so this returns without copying
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ready->pixelBuffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TEXTURE_SIZE, TEXTURE_SIZE,
+                            GL_RGB, GL_UNSIGNED_BYTE, (const GLvoid*) 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            ready->data = NULL;
+            ready->mapped = 0;
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TEXTURE_SIZE, TEXTURE_SIZE,
+                            GL_RGB, GL_UNSIGNED_BYTE, ready->data);
+            unmapTexelBuffer(ready);
+        }
+        pendingSwap = ready->pattern;
+        ready->uploadFrame = streamFrame;
+        
+        pthread_mutex_lock(&streamMutex);
+        ready->state = TEXEL_FREE;
+        pthread_mutex_unlock(&streamMutex);
+    }
+    
+    int remapped = mapTexelBuffers();
+    return ready != NULL || remapped;
+}
+
+// True while a requested texture has not reached the screen yet
+int textureStreamPending() {
+    int pending = (pendingSwap >= 0);
+    
+    pthread_mutex_lock(&streamMutex);
+    pending = pending || (requestedTexture >= 0);
+    for (int i = 0; i < PBO_RING_SIZE; i++) {
+        if (texelRing[i].state == TEXEL_BUSY || texelRing[i].state == TEXEL_READY) pending = 1;
+    }
+    pthread_mutex_unlock(&streamMutex);
+    return pending;
 }
 
 // Initialize lighting
@@ -237,62 +809,972 @@ void initLighting() {
     glLightfv(GL_LIGHT0, GL_DIFFUSE, lightDiffuse);
     glLightfv(GL_LIGHT0, GL_SPECULAR, lightSpecular);
     
+    // Color material only tracks ambient and diffuse, so specular is set here.
+    // Adding it after texturing keeps highlights on the dark texels too.
+    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, materialSpecular);
     glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, materialShininess);
+    glLightModeli(GL_LIGHT_MODEL_COLOR_CONTROL, GL_SEPARATE_SPECULAR_COLOR);
     
     printf("Enhanced lighting system initialized\n");
 }
 
+// Rounded faces need at least a fillet, a flat and a fillet quad per edge
+#define MIN_ROUNDED_SEGMENTS 3
+
+// Quads given to each fillet along a face edge; 0 for a sharp cube
+int filletSegments(int subdivisions) {
+    if (cubeRoundness <= 0.0f) return 0;
+    
+    int fillet = (int)(subdivisions * cubeRoundness + 0.5f);
+    if (fillet < 1) fillet = 1;
+    while (fillet > 1 && subdivisions - 2 * fillet < 1) fillet--;
+    return fillet;
+}
+
+// Face parameter of grid line i. Lines always fall on the fillet boundaries
+// (±inner), so every level shares the same flat faces and silhouette corners.
+float edgeCoordinate(int i, int segments, int fillet) {
+    float width = cubeRoundness * 0.5f; // Fillet span in [0, 1] face units
+    
+    if (fillet == 0) return (float)i / segments;
+    if (i <= fillet) return width * i / fillet;
+    if (i >= segments - fillet) return 1.0f - width * (segments - i) / fillet;
+    return width + (1.0f - 2.0f * width) * (i - fillet) / (segments - 2 * fillet);
+}
+
+// Fill one level's vertex and index arrays for the current roundness
+void buildCubeMesh(CubeMesh* mesh) {
+    int fillet = filletSegments(mesh->subdivisions);
+    int n = mesh->subdivisions;
+    if (fillet && n < 2 * fillet + 1) n = 2 * fillet + 1;
+    float inner = 1.0f - cubeRoundness;
+    MeshVertex* vertex = mesh->vertices;
+    GLushort* index = mesh->indices;
+    mesh->segments = n;
+    
+    for (int f = 0; f < 6; f++) {
+        const float* face = cubeFaces[f];
+        GLushort first = (GLushort)(vertex - mesh->vertices);
+        
+        for (int j = 0; j <= n; j++) {
+            for (int i = 0; i <= n; i++) {
+                float u = edgeCoordinate(i, n, fillet);
+                float v = edgeCoordinate(j, n, fillet);
+                float p[3], c[3], d[3];
+                
+                for (int k = 0; k < 3; k++) {
+                    p[k] = face[k] + u * face[3 + k] + v * face[6 + k];
+                    c[k] = (p[k] > inner) ? inner : (p[k] < -inner ? -inner : p[k]);
+                    d[k] = p[k] - c[k];
+                }
+                
+                // Points outside the inner box are pulled onto a sphere of radius cubeRoundness
+                float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                vertex->s = u;
+                vertex->t = v;
+                if (length > 0.0f) {
+                    vertex->nx = d[0] / length;
+                    vertex->ny = d[1] / length;
+                    vertex->nz = d[2] / length;
+                    vertex->x = c[0] + vertex->nx * cubeRoundness;
+                    vertex->y = c[1] + vertex->ny * cubeRoundness;
+                    vertex->z = c[2] + vertex->nz * cubeRoundness;
+                } else {
+                    vertex->nx = face[9];
+                    vertex->ny = face[10];
+                    vertex->nz = face[11];
+                    vertex->x = p[0];
+                    vertex->y = p[1];
+                    vertex->z = p[2];
+                }
+                vertex++;
+            }
+        }
+        
+        for (int j = 0; j < n; j++) {
+            for (int i = 0; i < n; i++) {
+                GLushort a = first + j * (n + 1) + i;
+                GLushort b = a + 1;
+                GLushort c = a + (n + 1) + 1;
+                GLushort d = a + (n + 1);
+                *index++ = a; *index++ = b; *index++ = c;
+                *index++ = a; *index++ = c; *index++ = d;
+            }
+        }
+    }
+    mesh->indexCount = (int)(index - mesh->indices);
+}
+
+// Allocate every LOD level once and build the meshes
+void initCubeMeshes() {
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        CubeMesh* mesh = &cubeMeshes[level];
+        int n = lodSubdivisions[level];
+        mesh->subdivisions = n;
+        if (n < MIN_ROUNDED_SEGMENTS) n = MIN_ROUNDED_SEGMENTS; // Room for the rounded build
+        mesh->vertices = (MeshVertex*) heapAlloc(6 * (n + 1) * (n + 1) * sizeof(MeshVertex));
+        mesh->indices = (GLushort*) heapAlloc(6 * n * n * 6 * sizeof(GLushort));
+        buildCubeMesh(mesh);
+    }
+    printf("Cube meshes initialized with %d LOD levels (%d to %d triangles)\n",
+           LOD_LEVELS, cubeMeshes[0].indexCount / 3, cubeMeshes[LOD_LEVELS - 1].indexCount / 3);
+}
+
+// Rebuild the meshes in place after the roundness changes
+void rebuildCubeMeshes() {
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        buildCubeMesh(&cubeMeshes[level]);
+    }
+}
+
+// Pick the coarsest level whose quads stay under LOD_TARGET_PIXELS on screen
+int selectCubeLod(float size, float depth) {
+    if (lodMode >= 0) return lodMode;
+    if (depth < 0.1f) return LOD_LEVELS - 1;
+    
+    float focal = (windowHeight * 0.5f) / tanf(FIELD_OF_VIEW * 0.5f * 3.14159265f / 180.0f);
+    float projectedSize = 2.0f * size * focal / depth;
+    
+    for (int level = 0; level < LOD_LEVELS; level++) {
+        if (projectedSize / lodSubdivisions[level] <= LOD_TARGET_PIXELS) return level;
+    }
+    return LOD_LEVELS - 1;
+}
+
 // Draw a textured cube
-void drawTexturedCube(float size) {
-    glBegin(GL_QUADS);
-    
-    // Front face
-    glNormal3f(0.0f, 0.0f, 1.0f);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-size, -size, size);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(size, -size, size);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(size, size, size);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(-size, size, size);
-    
-    // Back face
-    glNormal3f(0.0f, 0.0f, -1.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(-size, -size, -size);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(-size, size, -size);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(size, size, -size);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(size, -size, -size);
-    
-    // Top face
-    glNormal3f(0.0f, 1.0f, 0.0f);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(-size, size, -size);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-size, size, size);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(size, size, size);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(size, size, -size);
-    
-    // Bottom face
-    glNormal3f(0.0f, -1.0f, 0.0f);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(-size, -size, -size);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(size, -size, -size);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(size, -size, size);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(-size, -size, size);
-    
-    // Right face
-    glNormal3f(1.0f, 0.0f, 0.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(size, -size, -size);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(size, size, -size);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(size, size, size);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(size, -size, size);
-    
-    // Left face
-    glNormal3f(-1.0f, 0.0f, 0.0f);
-    glTexCoord2f(0.0f, 0.0f); glVertex3f(-size, -size, -size);
-    glTexCoord2f(1.0f, 0.0f); glVertex3f(-size, -size, size);
-    glTexCoord2f(1.0f, 1.0f); glVertex3f(-size, size, size);
-    glTexCoord2f(0.0f, 1.0f); glVertex3f(-size, size, -size);
+void drawTexturedCube(float size, int lod) {
+    CubeMesh* mesh = &cubeMeshes[lod];
+    
+    glPushMatrix();
+    glScalef(size, size, size);
+    glInterleavedArrays(GL_T2F_N3F_V3F, 0, mesh->vertices);
+    glDrawElements(GL_TRIANGLES, mesh->indexCount, GL_UNSIGNED_SHORT, mesh->indices);
+    glPopMatrix();
+}
+
+// Clustered lighting: point lights are binned into screen tiles by depth slice
+// on the CPU, and the fragment shader only walks its own cluster's list.
+const char* clusterVertexShader =
+    "varying vec3 eyePosition;\n"
+    "varying vec3 eyeNormal;\n"
+    "void main() {\n"
+    "    eyePosition = vec3(gl_ModelViewMatrix * gl_Vertex);\n"
+    "    eyeNormal = gl_NormalMatrix * gl_Normal;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "    gl_Position = ftransform();\n"
+    "}\n";
+
+const char* clusterFragmentShader =
+    "uniform sampler2D diffuseMap;\n"
+    "uniform samplerBuffer lightData;\n"     // Eye position + radius, then colors
+    "uniform isamplerBuffer clusterRanges;\n" // Offset into lightIndices, light count
+    "uniform usamplerBuffer lightIndices;\n"
+    "uniform vec2 viewportSize;\n"
+    "uniform float shininess;\n"
+    "varying vec3 eyePosition;\n"
+    "varying vec3 eyeNormal;\n"
+    "void main() {\n"
+    "    vec3 n = normalize(eyeNormal);\n"
+    "    vec3 v = normalize(-eyePosition);\n"
+    "    float depth = max(-eyePosition.z, NEAR_PLANE);\n"
+    "    float slice = clamp(floor(log(depth / NEAR_PLANE) / log(FAR_PLANE / NEAR_PLANE) * CLUSTER_Z), 0.0, CLUSTER_Z - 1.0);\n"
+    "    vec2 tile = clamp(floor(gl_FragCoord.xy / viewportSize * vec2(CLUSTER_X, CLUSTER_Y)),\n"
+    "                      vec2(0.0), vec2(CLUSTER_X - 1.0, CLUSTER_Y - 1.0));\n"
+    "    ivec2 range = texelFetch(clusterRanges, int((slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x)).xy;\n"
+    "\n"
+    "    // The original key light still applies on top of the point lights\n"
+    "    vec3 l = normalize(gl_LightSource[0].position.xyz - eyePosition);\n"
+    "    float keyLambert = max(dot(n, l), 0.0);\n"
+    "    vec3 diffuse = gl_LightSource[0].ambient.rgb + gl_LightSource[0].diffuse.rgb * keyLambert;\n"
+    "    vec3 specular = vec3(0.0);\n"
+    "    if (keyLambert > 0.0) specular = gl_LightSource[0].specular.rgb * pow(max(dot(n, normalize(l + v)), 0.0), shininess);\n"
+    "\n"
+    "    for (int i = 0; i < MAX_LIGHTS_PER_CLUSTER; i++) {\n"
+    "        if (i >= range.y) break;\n"
+    "        int index = int(texelFetch(lightIndices, range.x + i).r);\n"
+    "        vec4 positionRadius = texelFetch(lightData, index);\n"
+    "        vec3 color = texelFetch(lightData, index + MAX_POINT_LIGHTS).rgb;\n"
+    "        vec3 toLight = positionRadius.xyz - eyePosition;\n"
+    "        float distance = length(toLight);\n"
+    "        if (distance >= positionRadius.w) continue;\n"
+    "        float attenuation = 1.0 - distance / positionRadius.w;\n"
+    "        attenuation *= attenuation;\n"
+    "        l = toLight / distance;\n"
+    "        float lambert = max(dot(n, l), 0.0);\n"
+    "        diffuse += color * lambert * attenuation;\n"
+    "        if (lambert > 0.0) specular += color * pow(max(dot(n, normalize(l + v)), 0.0), shininess) * attenuation;\n"
+    "    }\n"
+    "\n"
+    "    vec4 texel = texture2D(diffuseMap, gl_TexCoord[0].st);\n"
+    "    // Same material as the fixed-function path, with specular added after texturing\n"
+    "    gl_FragColor = vec4(diffuse * gl_Color.rgb * texel.rgb + specular * gl_FrontMaterial.specular.rgb,\n"
+    "                        gl_Color.a * texel.a);\n"
+    "}\n";
+
+// Transform a world-space point by the camera set up in display()
+void worldToEye(float x, float y, float z, float* eye) {
+    float ay = cameraAngleY * 3.14159265f / 180.0f;
+    float ax = cameraAngleX * 3.14159265f / 180.0f;
+    float rotatedX = x * cosf(ay) + z * sinf(ay);
+    float rotatedZ = -x * sinf(ay) + z * cosf(ay);
+    eye[0] = rotatedX;
+    eye[1] = y * cosf(ax) - rotatedZ * sinf(ax);
+    eye[2] = y * sinf(ax) + rotatedZ * cosf(ax) - cameraDistance;
+}
+
+float randomUnit(unsigned int* seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return (*seed >> 8) / 16777216.0f;
+}
+
+// Scatter every light slot with a fixed seed; pointLights.count picks how many are live
+void initPointLights(int count) {
+    unsigned int seed = 12345;
+    
+    for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
+        pointLights.baseX[i] = randomUnit(&seed) * 2.0f - 1.0f;
+        pointLights.baseY[i] = randomUnit(&seed) * 2.0f - 1.0f;
+        pointLights.baseZ[i] = randomUnit(&seed) * 4.0f - 2.0f;
+        pointLights.radius[i] = 0.6f + randomUnit(&seed);
+        
+        // Saturated colors read better than random grey
+        float r = randomUnit(&seed), g = randomUnit(&seed), b = randomUnit(&seed);
+        float brightest = fmaxf(r, fmaxf(g, b));
+        pointLights.red[i] = r / brightest;
+        pointLights.green[i] = g / brightest;
+        pointLights.blue[i] = b / brightest;
+    }
+    pointLights.count = count;
+}
+
+int depthSlice(float depth) {
+    if (depth <= NEAR_PLANE) return 0;
+    int slice = (int)(logf(depth / NEAR_PLANE) / logf(FAR_PLANE / NEAR_PLANE) * CLUSTER_Z);
+    return (slice >= CLUSTER_Z) ? CLUSTER_Z - 1 : slice;
+}
+
+// Move the lights around the grid and bring them into eye space
+void updatePointLights() {
+    float extent = showMultipleCubes ? cubeGridRadius * 2.5f + 1.5f : 2.5f;
+    float orbit = lightOrbitAngle * 3.14159265f / 180.0f;
+    float orbitCos = cosf(orbit), orbitSin = sinf(orbit);
+    float ay = cameraAngleY * 3.14159265f / 180.0f;
+    float ax = cameraAngleX * 3.14159265f / 180.0f;
+    float cosY = cosf(ay), sinY = sinf(ay), cosX = cosf(ax), sinX = sinf(ax);
+    
+    for (int i = 0; i < pointLights.count; i++) {
+        // Orbit within the grid's plane
+        float x = (pointLights.baseX[i] * orbitCos - pointLights.baseY[i] * orbitSin) * extent;
+        float y = (pointLights.baseX[i] * orbitSin + pointLights.baseY[i] * orbitCos) * extent;
+        float z = pointLights.baseZ[i];
+        
+        float rotatedZ = -x * sinY + z * cosY;
+        pointLights.eyeX[i] = x * cosY + z * sinY;
+        pointLights.eyeY[i] = y * cosX - rotatedZ * sinX;
+        pointLights.eyeZ[i] = y * sinX + rotatedZ * cosX - cameraDistance;
+    }
+    
+    for (int i = 0; i < pointLights.count; i++) {
+        float depth = -pointLights.eyeZ[i];
+        float r = pointLights.radius[i];
+        if (depth + r < NEAR_PLANE || depth - r > FAR_PLANE) {
+            pointLights.minSlice[i] = 1; // Empty range, never binned
+            pointLights.maxSlice[i] = 0;
+        } else {
+            pointLights.minSlice[i] = depthSlice(depth - r);
+            pointLights.maxSlice[i] = depthSlice(depth + r);
+        }
+    }
+}
+
+// Tile range covered by [low, high] in normalized device coordinates; 0 if off screen
+int tileRange(float low, float high, int tiles, int* first, int* last) {
+    if (high < -1.0f || low > 1.0f) return 0;
+    *first = (int) floorf((low * 0.5f + 0.5f) * tiles);
+    *last = (int) floorf((high * 0.5f + 0.5f) * tiles);
+    if (*first < 0) *first = 0;
+    if (*last >= tiles) *last = tiles - 1;
+    return 1;
+}
+
+// Bin every live light into the slices owned by one thread. Slices are
+// interleaved across threads so near and far work is spread evenly, and no
+// two threads ever write the same cluster.
+void binClusterSlices(int thread, int threadCount) {
+    const float sliceRatio = FAR_PLANE / NEAR_PLANE;
+    int overflows = 0;
+    
+    for (int z = thread; z < CLUSTER_Z; z += threadCount) {
+        float sliceNear = NEAR_PLANE * powf(sliceRatio, (float) z / CLUSTER_Z);
+        float sliceFar = NEAR_PLANE * powf(sliceRatio, (float)(z + 1) / CLUSTER_Z);
+        int* counts = &clusterCounts[z * CLUSTER_Y * CLUSTER_X];
+        memset(counts, 0, CLUSTER_X * CLUSTER_Y * sizeof(int));
+        
+        for (int i = 0; i < pointLights.count; i++) {
+            if (z < pointLights.minSlice[i] || z > pointLights.maxSlice[i]) continue;
+            
+            // Conservative screen bounds of the light's box clipped to this slice
+            float r = pointLights.radius[i];
+            float depth = -pointLights.eyeZ[i];
+            float nearest = fmaxf(depth - r, sliceNear);
+            float farthest = fminf(depth + r, sliceFar);
+            float left = pointLights.eyeX[i] - r, right = pointLights.eyeX[i] + r;
+            float bottom = pointLights.eyeY[i] - r, top = pointLights.eyeY[i] + r;
+            int x0, x1, y0, y1;
+            
+            if (!tileRange(fminf(left / nearest, left / farthest) * clusterFocalX,
+                           fmaxf(right / nearest, right / farthest) * clusterFocalX,
+                           CLUSTER_X, &x0, &x1)) continue;
+            if (!tileRange(fminf(bottom / nearest, bottom / farthest) * clusterFocalY,
+                           fmaxf(top / nearest, top / farthest) * clusterFocalY,
+                           CLUSTER_Y, &y0, &y1)) continue;
+            
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    int cluster = (z * CLUSTER_Y + y) * CLUSTER_X + x;
+                    int n = clusterCounts[cluster];
+                    if (n >= MAX_LIGHTS_PER_CLUSTER) {
+                        overflows++;
+                        continue;
+                    }
+                    clusterSlots[cluster * MAX_LIGHTS_PER_CLUSTER + n] = (unsigned short) i;
+                    clusterCounts[cluster] = n + 1;
+                }
+            }
+        }
+    }
+    clusterOverflowCounts[thread] = overflows;
+}
+
+// Helper thread: bins its share of slices whenever the generation changes
+void* clusterWorker(void* arg) {
+    int thread = (int)(long) arg;
+    int seen = 0;
+    
+    pthread_mutex_lock(&clusterMutex);
+    while (1) {
+        while (clusterGeneration == seen) pthread_cond_wait(&clusterStart, &clusterMutex);
+        if (clusterGeneration < 0) break;
+        seen = clusterGeneration;
+        int threadCount = clusterActiveThreads;
+        pthread_mutex_unlock(&clusterMutex);
+        
+        if (thread < threadCount) binClusterSlices(thread, threadCount);
+        
+        pthread_mutex_lock(&clusterMutex);
+        if (--clusterPending == 0) pthread_cond_signal(&clusterDone);
+    }
+    pthread_mutex_unlock(&clusterMutex);
+    return NULL;
+}
+
+void startClusterWorkers() {
+    for (int i = 1; i < CLUSTER_THREADS; i++) {
+        if (pthread_create(&clusterThreads[i], NULL, clusterWorker, (void*)(long) i) != 0) {
+            fprintf(stderr, "Failed to start light binning thread\n");
+            exit(1);
+        }
+    }
+    clusterWorkersStarted = 1;
+}
+
+void shutdownClusteredLighting() {
+    if (!clusterWorkersStarted) return;
+    
+    pthread_mutex_lock(&clusterMutex);
+    clusterGeneration = -1;
+    pthread_cond_broadcast(&clusterStart);
+    pthread_mutex_unlock(&clusterMutex);
+    for (int i = 1; i < CLUSTER_THREADS; i++) {
+        pthread_join(clusterThreads[i], NULL);
+    }
+    clusterWorkersStarted = 0;
+}
+
+// Bin all live lights; the calling thread takes slice share 0. The compact
+// list goes to ranges (offset, count per cluster) and indices.
+void binPointLights(int* ranges, unsigned short* indices) {
+    float tanHalf = tanf(FIELD_OF_VIEW * 0.5f * 3.14159265f / 180.0f);
+    clusterFocalY = 1.0f / tanHalf;
+    clusterFocalX = clusterFocalY * windowHeight / windowWidth;
+    
+    pthread_mutex_lock(&clusterMutex);
+    clusterGeneration++;
+    clusterPending = CLUSTER_THREADS - 1;
+    pthread_cond_broadcast(&clusterStart);
+    pthread_mutex_unlock(&clusterMutex);
+    
+    binClusterSlices(0, clusterActiveThreads);
     
+    pthread_mutex_lock(&clusterMutex);
+    while (clusterPending > 0) pthread_cond_wait(&clusterDone, &clusterMutex);
+    pthread_mutex_unlock(&clusterMutex);
+    
+    clusterOverflows = 0;
+    for (int i = 0; i < clusterActiveThreads; i++) {
+        clusterOverflows += clusterOverflowCounts[i];
+    }
+    
+    // Pack the per-cluster slots into one list with an offset and count per cluster
+    int offset = 0;
+    for (int c = 0; c < CLUSTER_COUNT; c++) {
+        int n = clusterCounts[c];
+        ranges[c * 2] = offset;
+        ranges[c * 2 + 1] = n;
+        memcpy(&indices[offset], &clusterSlots[c * MAX_LIGHTS_PER_CLUSTER], n * sizeof(unsigned short));
+        offset += n;
+    }
+    clusterReferences = offset;
+}
+
+GLuint compileShader(GLenum type, const char* source) {
+    char header[512];
+    snprintf(header, sizeof(header),
+             "#version 140\n" // Buffer textures; built-in GL state needs a compatibility context
+             "#define MAX_POINT_LIGHTS %d\n"
+             "#define MAX_LIGHTS_PER_CLUSTER %d\n"
+             "#define CLUSTER_X %d.0\n#define CLUSTER_Y %d.0\n#define CLUSTER_Z %d.0\n"
+             "#define NEAR_PLANE %f\n#define FAR_PLANE %f\n",
+             MAX_POINT_LIGHTS, MAX_LIGHTS_PER_CLUSTER, CLUSTER_X, CLUSTER_Y, CLUSTER_Z,
+             NEAR_PLANE, FAR_PLANE);
+    const char* sources[2] = {header, source};
+    GLint status;
+    
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 2, sources, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "Shader compile failed:\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Returns 0 if the buffer could not be mapped
+int createClusterStream(ClusterStream* stream, GLenum format, size_t bytes) {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, stream->buffer);
+    glBufferStorage(GL_TEXTURE_BUFFER, bytes, NULL, flags);
+    stream->data = glMapBufferRange(GL_TEXTURE_BUFFER, 0, bytes, flags);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    
+    glGenTextures(1, &stream->texture);
+    glBindTexture(GL_TEXTURE_BUFFER, stream->texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, stream->buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return stream->data != NULL;
+}
+
+// Initialize clustered lighting; leaves clusterProgram at 0 if shaders are unavailable
+void initClusteredLighting() {
+    initPointLights(256);
+    startClusterWorkers();
+    
+    // Persistent mapping needs GL 4.4 or ARB_buffer_storage
+    const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "GL_ARB_buffer_storage")) {
+        fprintf(stderr, "Clustered lighting needs GL_ARB_buffer_storage\n");
+        return;
+    }
+    for (int frame = 0; frame < CLUSTER_BUFFER_FRAMES; frame++) {
+        ClusterStream* streams = clusterStreams[frame];
+        int mapped = createClusterStream(&streams[STREAM_LIGHT_DATA], GL_RGBA32F,
+                                         2 * MAX_POINT_LIGHTS * 4 * sizeof(float));
+        mapped &= createClusterStream(&streams[STREAM_RANGES], GL_RG32I, CLUSTER_COUNT * 2 * sizeof(int));
+        mapped &= createClusterStream(&streams[STREAM_INDICES], GL_R16UI,
+                                      CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(unsigned short));
+        if (!mapped) {
+            fprintf(stderr, "Clustered lighting buffers could not be mapped\n");
+            return;
+        }
+    }
+    
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, clusterVertexShader);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, clusterFragmentShader);
+    if (!vertexShader || !fragmentShader) return;
+    
+    GLint status;
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    if (!status) {
+        fprintf(stderr, "Clustered lighting program failed to link\n");
+        glDeleteProgram(program);
+        return;
+    }
+    
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "diffuseMap"), 0);
+    glUniform1i(glGetUniformLocation(program, "lightData"), 1);
+    glUniform1i(glGetUniformLocation(program, "clusterRanges"), 2);
+    glUniform1i(glGetUniformLocation(program, "lightIndices"), 3);
+    glUseProgram(0);
+    viewportSizeUniform = glGetUniformLocation(program, "viewportSize");
+    shininessUniform = glGetUniformLocation(program, "shininess");
+    clusterProgram = program;
+    printf("Clustered lighting initialized (%dx%dx%d clusters, %d threads)\n",
+           CLUSTER_X, CLUSTER_Y, CLUSTER_Z, CLUSTER_THREADS);
+}
+
+// Bin this frame's lights straight into its slot of the mapped buffer ring.
+// The slot was last read CLUSTER_BUFFER_FRAMES frames ago, which the swap
+// throttling of the GL driver has long since retired.
+void updateClusters() {
+    ClusterStream* streams = clusterStreams[clusterFrame];
+    clusterFrame = (clusterFrame + 1) % CLUSTER_BUFFER_FRAMES;
+    
+    updatePointLights();
+    binPointLights((int*) streams[STREAM_RANGES].data, (unsigned short*) streams[STREAM_INDICES].data);
+    
+    float* lightData = (float*) streams[STREAM_LIGHT_DATA].data;
+    for (int i = 0; i < pointLights.count; i++) {
+        float* position = &lightData[i * 4];
+        float* color = &lightData[(MAX_POINT_LIGHTS + i) * 4];
+        position[0] = pointLights.eyeX[i];
+        position[1] = pointLights.eyeY[i];
+        position[2] = pointLights.eyeZ[i];
+        position[3] = pointLights.radius[i];
+        color[0] = pointLights.red[i];
+        color[1] = pointLights.green[i];
+        color[2] = pointLights.blue[i];
+        color[3] = 1.0f;
+    }
+    
+    for (int i = 0; i < CLUSTER_STREAMS; i++) {
+        glActiveTexture(GL_TEXTURE1 + i);
+        glBindTexture(GL_TEXTURE_BUFFER, streams[i].texture);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Mark each point light with a dot in its own color
+void drawPointLights() {
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glPointSize(4.0f);
+    glPushMatrix();
+    glLoadIdentity();
+    glBegin(GL_POINTS);
+    for (int i = 0; i < pointLights.count; i++) {
+        glColor3f(pointLights.red[i], pointLights.green[i], pointLights.blue[i]);
+        glVertex3f(pointLights.eyeX[i], pointLights.eyeY[i], pointLights.eyeZ[i]);
+    }
     glEnd();
+    glPopMatrix();
+    glPopAttrib();
+}
+
+double elapsedMilliseconds(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1.0e6;
+}
+
+// --light-bench: time the CPU side of clustered lighting across light counts
+void runLightBenchmark() {
+    const int iterations = 200;
+    const int threadCounts[2] = {1, CLUSTER_THREADS};
+    static double samples[200];
+    static int ranges[CLUSTER_COUNT * 2];
+    static unsigned short indices[CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER];
+    
+    windowWidth = 1920;
+    windowHeight = 1080;
+    showMultipleCubes = 1;
+    cubeGridRadius = MAX_GRID_RADIUS;
+    cameraDistance = 30.0f;
+    cameraAngleX = -30.0f;
+    initPointLights(0);
+    startClusterWorkers();
+    
+    printf("Clustered light binning, %dx%dx%d clusters, %d iterations\n",
+           CLUSTER_X, CLUSTER_Y, CLUSTER_Z, iterations);
+    printf("%7s %8s %10s %10s %14s %10s %10s\n",
+           "lights", "threads", "mean ms", "stddev ms", "lights/cluster", "overflows", "written KB");
+    
+    for (int count = 16; count <= MAX_POINT_LIGHTS; count *= 2) {
+        for (int t = 0; t < 2; t++) {
+            pointLights.count = count;
+            clusterActiveThreads = threadCounts[t];
+            double sum = 0.0, sumSquares = 0.0;
+            
+            for (int i = -10; i < iterations; i++) {
+                struct timespec start, end;
+                lightOrbitAngle += 0.5f;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                updatePointLights();
+                binPointLights(ranges, indices);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                if (i < 0) continue; // Warm-up
+                samples[i] = elapsedMilliseconds(&start, &end);
+                sum += samples[i];
+            }
+            
+            double mean = sum / iterations;
+            for (int i = 0; i < iterations; i++) {
+                sumSquares += (samples[i] - mean) * (samples[i] - mean);
+            }
+            
+            int occupied = 0;
+            for (int c = 0; c < CLUSTER_COUNT; c++) {
+                if (clusterCounts[c] > 0) occupied++;
+            }
+            double writtenKB = (count * 2 * 4 * sizeof(float) + CLUSTER_COUNT * 2 * sizeof(int)
+                                + clusterReferences * sizeof(unsigned short)) / 1024.0;
+            printf("%7d %8d %10.4f %10.4f %14.2f %10d %10.1f\n", count, threadCounts[t], mean,
+                   sqrt(sumSquares / iterations),
+                   occupied ? (double) clusterReferences / occupied : 0.0,
+                   clusterOverflows, writtenKB);
+        }
+    }
+    shutdownClusteredLighting();
+}
+
+// Depth of a world-space point along the camera's view direction
+float viewDepth(float x, float y, float z) {
+    float eye[3];
+    worldToEye(x, y, z, eye);
+    return -eye[2];
+}
+
+// Depth as an unsigned key whose integer order matches the float order
+unsigned int depthSortKey(float depth) {
+    unsigned int bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Stable LSD radix sort on depth, one byte per pass, with scratch from the
+// frame arena so sorting never reaches the heap (glibc's qsort mallocs)
+void sortCubesByDepth(CubeInstance* instances, int count) {
+    CubeInstance* scratch = (CubeInstance*) arenaAlloc(&frameArena, count * sizeof(CubeInstance));
+    if (!scratch) return; // Counted as an arena overflow; draw order only costs fill rate
+    
+    CubeInstance* source = instances;
+    CubeInstance* target = scratch;
+    for (int shift = 0; shift < 32; shift += 8) {
+        int offsets[257] = {0};
+        for (int k = 0; k < count; k++) {
+            offsets[((depthSortKey(source[k].depth) >> shift) & 0xFF) + 1]++;
+        }
+        for (int b = 0; b < 256; b++) offsets[b + 1] += offsets[b];
+        for (int k = 0; k < count; k++) {
+            target[offsets[(depthSortKey(source[k].depth) >> shift) & 0xFF]++] = source[k];
+        }
+        
+        CubeInstance* swap = source;
+        source = target;
+        target = swap;
+    }
+    // An even number of passes leaves the result back in instances
+}
+
+// Build this frame's cube grid in the frame arena, sorted front to back
+CubeInstance* buildCubeInstances(int* count) {
+    int n = cubeGridRadius;
+    int side = 2 * n + 1;
+    CubeInstance* instances = (CubeInstance*) arenaAlloc(&frameArena, side * side * sizeof(CubeInstance));
+    
+    *count = 0;
+    if (!instances) return NULL;
+    
+    for (int i = -n; i <= n; i++) {
+        for (int j = -n; j <= n; j++) {
+            CubeInstance* cube = &instances[(*count)++];
+            cube->x = i * 2.5f;
+            cube->y = j * 2.5f;
+            cube->z = 0.0f;
+            cube->angleX = rotationX + i * 30;
+            cube->angleY = rotationY + j * 30;
+            
+            // Different colors for each cube
+            cube->r = (float)(i + n) / (2 * n);
+            cube->g = (float)(j + n) / (2 * n);
+            cube->b = 1.0f - (cube->r + cube->g) * 0.5f;
+            cube->depth = viewDepth(cube->x, cube->y, cube->z);
+            cube->lod = selectCubeLod(0.8f, cube->depth);
+        }
+    }
+    
+    // Front-to-back order lets the depth test reject hidden fragments early
+    sortCubesByDepth(instances, *count);
+    return instances;
+}
+
+int queuePush(FrameQueue* queue, int value) {
+    int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    int next = (tail + 1) % RECORD_QUEUE_CAPACITY;
+    if (next == atomic_load_explicit(&queue->head, memory_order_acquire)) return 0;
+    
+    queue->items[tail] = value;
+    atomic_store_explicit(&queue->tail, next, memory_order_release);
+    return 1;
+}
+
+int queuePop(FrameQueue* queue, int* value) {
+    int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&queue->tail, memory_order_acquire)) return 0;
+    
+    *value = queue->items[head];
+    atomic_store_explicit(&queue->head, (head + 1) % RECORD_QUEUE_CAPACITY, memory_order_release);
+    return 1;
+}
+
+int queueDepth(FrameQueue* queue) {
+    int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return (tail - head + RECORD_QUEUE_CAPACITY) % RECORD_QUEUE_CAPACITY;
+}
+
+void queueInit(FrameQueue* queue) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+}
+
+// Convert a bottom-up BGRA frame to top-down full-range I420
+void convertToI420(const unsigned char* bgra, unsigned char* planes, int width, int height) {
+    unsigned char* yPlane = planes;
+    unsigned char* uPlane = planes + width * height;
+    unsigned char* vPlane = uPlane + (width / 2) * (height / 2);
+    
+    for (int row = 0; row < height; row += 2) {
+        const unsigned char* top = bgra + (size_t)(height - 1 - row) * width * 4;
+        const unsigned char* bottom = top - (size_t) width * 4;
+        unsigned char* yTop = yPlane + (size_t) row * width;
+        unsigned char* yBottom = yTop + width;
+        
+        for (int x = 0; x < width; x += 2) {
+            int b = 0, g = 0, r = 0;
+            for (int k = 0; k < 2; k++) {
+                const unsigned char* t = top + (x + k) * 4;
+                const unsigned char* u = bottom + (x + k) * 4;
+                yTop[x + k] = (unsigned char)((77 * t[2] + 150 * t[1] + 29 * t[0]) >> 8);
+                yBottom[x + k] = (unsigned char)((77 * u[2] + 150 * u[1] + 29 * u[0]) >> 8);
+                b += t[0] + u[0];
+                g += t[1] + u[1];
+                r += t[2] + u[2];
+            }
+            b >>= 2; g >>= 2; r >>= 2;
+            size_t chroma = (size_t)(row / 2) * (width / 2) + x / 2;
+            uPlane[chroma] = (unsigned char)(((-43 * r - 85 * g + 128 * b) >> 8) + 128);
+            vPlane[chroma] = (unsigned char)(((128 * r - 107 * g - 21 * b) >> 8) + 128);
+        }
+    }
+}
+
+// Convert a bottom-up BGRA frame to top-down RGB24
+void convertToRGB(const unsigned char* bgra, unsigned char* rgb, int width, int height) {
+    for (int row = 0; row < height; row++) {
+        const unsigned char* source = bgra + (size_t)(height - 1 - row) * width * 4;
+        for (int x = 0; x < width; x++) {
+            *rgb++ = source[x * 4 + 2];
+            *rgb++ = source[x * 4 + 1];
+            *rgb++ = source[x * 4];
+        }
+    }
+}
+
+// Encoder thread: converts mapped frames in place and hands the slots back
+// Wakes the encoder after a queuePush or a stop; taking the mutex means the
+// signal cannot slip in between the encoder's check and its wait
+void wakeEncoder() {
+    pthread_mutex_lock(&encoderMutex);
+    pthread_cond_signal(&encoderWake);
+    pthread_mutex_unlock(&encoderMutex);
+}
+
+void* encoderWorker(void* arg) {
+    size_t outputBytes = recordY4M ? (size_t) recordWidth * recordHeight * 3 / 2
+                                   : (size_t) recordWidth * recordHeight * 3;
+    
+    while (1) {
+        int slot;
+        if (!queuePop(&filledFrames, &slot)) {
+            // Sleep until a frame is queued or recording stops; the queue stays lock-free
+            pthread_mutex_lock(&encoderMutex);
+            while (queueDepth(&filledFrames) == 0 && atomic_load(&encoderRunning)) {
+                pthread_cond_wait(&encoderWake, &encoderMutex);
+            }
+            pthread_mutex_unlock(&encoderMutex);
+            if (!queuePop(&filledFrames, &slot)) break; // Drained after stop
+        }
+        
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (recordY4M) {
+            convertToI420(recordMapped[slot], recordPlanes, recordWidth, recordHeight);
+            fputs("FRAME\n", recordFile);
+        } else {
+            convertToRGB(recordMapped[slot], recordPlanes, recordWidth, recordHeight);
+        }
+        queuePush(&freeFrames, slot); // Render thread unmaps and reuses it
+        fwrite(recordPlanes, 1, outputBytes, recordFile);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        
+        encodeMilliseconds += elapsedMilliseconds(&start, &end);
+        framesEncoded++;
+    }
+    return NULL;
+}
+
+// Returns 0 if the output could not be opened
+int startRecording() {
+    // 4:2:0 chroma needs even dimensions
+    recordWidth = windowWidth & ~1;
+    recordHeight = windowHeight & ~1;
+    recordFrameBytes = (size_t) recordWidth * recordHeight * 4;
+    recordY4M = recordPipe || strstr(recordPath, ".y4m") != NULL;
+    
+    recordFile = recordPipe ? popen(recordPipe, "w") : fopen(recordPath, "wb");
+    if (!recordFile) {
+        fprintf(stderr, "Could not open %s\n", recordPipe ? recordPipe : recordPath);
+        return 0;
+    }
+    if (recordY4M) {
+        // The conversion keeps full-range BT.601 levels, so say so
+        fprintf(recordFile, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+                recordWidth, recordHeight);
+    }
+    
+    recordPlanes = (unsigned char*) heapAlloc((size_t) recordWidth * recordHeight * 3);
+    queueInit(&filledFrames);
+    queueInit(&freeFrames);
+    
+    glGenBuffers(RECORD_SLOTS, recordPixelBuffers);
+    for (int i = 0; i < RECORD_SLOTS; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, recordPixelBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, recordFrameBytes, NULL, GL_STREAM_READ);
+        idleSlots[i] = i;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    idleSlotCount = RECORD_SLOTS;
+    pendingSlot = -1;
+    
+    recordFrameIndex = 0;
+    framesCaptured = framesDropped = framesEncoded = 0;
+    queueHighWater = 0;
+    captureMilliseconds = encodeMilliseconds = 0.0;
+    
+    atomic_store(&encoderRunning, 1);
+    if (pthread_create(&encoderThread, NULL, encoderWorker, NULL) != 0) {
+        fprintf(stderr, "Failed to start encoder thread\n");
+        exit(1);
+    }
+    recording = 1;
+    printf("Recording %dx%d to %s (%s)\n", recordWidth, recordHeight,
+           recordPipe ? recordPipe : recordPath, recordY4M ? "Y4M 4:2:0" : "raw RGB24");
+    return 1;
+}
+
+// Unmap buffers the encoder has finished with so they can be read into again
+void reclaimRecordSlots() {
+    int slot;
+    while (queuePop(&freeFrames, &slot)) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, recordPixelBuffers[slot]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        idleSlots[idleSlotCount++] = slot;
+    }
+}
+
+// Map last frame's readback and hand it to the encoder without copying
+void queuePendingFrame() {
+    if (pendingSlot < 0) return;
+    
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, recordPixelBuffers[pendingSlot]);
+    recordMapped[pendingSlot] = (const unsigned char*) glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (recordMapped[pendingSlot]) {
+        queuePush(&filledFrames, pendingSlot);
+        wakeEncoder();
+        framesCaptured++;
+        int depth = queueDepth(&filledFrames);
+        if (depth > queueHighWater) queueHighWater = depth;
+    } else {
+        idleSlots[idleSlotCount++] = pendingSlot;
+        framesDropped++;
+    }
+    pendingSlot = -1;
+}
+
+// Called before each swap: queue the previous readback and start this frame's.
+// A frame is dropped rather than stalling the render when every buffer is busy.
+void captureFrame() {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    reclaimRecordSlots();
+    queuePendingFrame();
+    
+    // The readback is asynchronous; by next frame it has landed in the buffer
+    if (idleSlotCount > 0) {
+        pendingSlot = idleSlots[--idleSlotCount];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, recordPixelBuffers[pendingSlot]);
+        glReadPixels(0, 0, recordWidth, recordHeight, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*) 0);
+    } else {
+        framesDropped++;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    recordFrameIndex++;
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    captureMilliseconds += elapsedMilliseconds(&start, &end);
+}
+
+void stopRecording() {
+    if (!recording) return;
+    
+    // Flush the readback still in flight, then let the encoder drain
+    queuePendingFrame();
+    recording = 0;
+    atomic_store(&encoderRunning, 0);
+    wakeEncoder();
+    pthread_join(encoderThread, NULL);
+    
+    reclaimRecordSlots();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteBuffers(RECORD_SLOTS, recordPixelBuffers);
+    if (recordPipe) {
+        pclose(recordFile);
+    } else {
+        fclose(recordFile);
+    }
+    recordFile = NULL;
+    heapFree(recordPlanes);
+    recordPlanes = NULL;
+    
+    unsigned long frames = recordFrameIndex ? recordFrameIndex : 1;
+    printf("\n=== Recording Report ===\n");
+    printf("Frames: %lu rendered, %lu captured, %lu encoded, %lu dropped\n",
+           recordFrameIndex, framesCaptured, framesEncoded, framesDropped);
+    printf("Queue: %d / %d slots high-water\n", queueHighWater, RECORD_SLOTS);
+    printf("Render thread: %.3f ms/frame for capture (%.1f%% of a 60 Hz frame)\n",
+           captureMilliseconds / frames, 100.0 * captureMilliseconds / frames / (1000.0 / 60.0));
+    printf("Encoder thread: %.3f ms/frame\n", framesEncoded ? encodeMilliseconds / framesEncoded : 0.0);
+    printf("========================\n\n");
 }
 
 // Display function
 void display() {
+    unsigned long heapBefore = heapAllocations;
+    int overflowsBefore = frameArena.overflows;
+    arenaReset(&frameArena);
+    
+    // A texture switch is an event, not steady state, and the driver may
+    // allocate inside the map and upload; count those apart from the budget
+    if (pollTextureStream()) {
+        unsigned long uploadHeap = heapAllocations - heapBefore;
+        uploadAllocations += uploadHeap;
+        heapBefore += uploadHeap;
+    }
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
     // Set up camera
@@ -318,25 +1800,30 @@ void display() {
         glDisable(GL_LIGHTING);
     }
     
+    // Clustered mode replaces fixed-function lighting with the cluster shader
+    int useClusters = clusteredLighting && clusterProgram && lightingEnabled && !wireframeMode;
+    if (useClusters) {
+        updateClusters();
+        glUseProgram(clusterProgram);
+        glUniform2f(viewportSizeUniform, (float) windowWidth, (float) windowHeight);
+        glUniform1f(shininessUniform, materialShininess);
+    }
+    
     if (showMultipleCubes) {
-        // Draw multiple cubes in a formation
-        for (int i = -1; i <= 1; i++) {
-            for (int j = -1; j <= 1; j++) {
-                glPushMatrix();
-                glTranslatef(i * 2.5f, j * 2.5f, 0.0f);
-                glRotatef(rotationX + i * 30, 1.0f, 0.0f, 0.0f);
-                glRotatef(rotationY + j * 30, 0.0f, 1.0f, 0.0f);
-                glRotatef(rotationZ, 0.0f, 0.0f, 1.0f);
-                
-                // Different colors for each cube
-                float r = (i + 1) * 0.5f;
-                float g = (j + 1) * 0.5f;
-                float b = 1.0f - (r + g) * 0.5f;
-                glColor3f(r, g, b);
-                
-                drawTexturedCube(0.8f);
-                glPopMatrix();
-            }
+        // Draw multiple cubes in a formation, nearest first
+        int count = 0;
+        CubeInstance* instances = buildCubeInstances(&count);
+        for (int k = 0; k < count; k++) {
+            CubeInstance* cube = &instances[k];
+            glPushMatrix();
+            glTranslatef(cube->x, cube->y, cube->z);
+            glRotatef(cube->angleX, 1.0f, 0.0f, 0.0f);
+            glRotatef(cube->angleY, 0.0f, 1.0f, 0.0f);
+            glRotatef(rotationZ, 0.0f, 0.0f, 1.0f);
+            glColor3f(cube->r, cube->g, cube->b);
+            
+            drawTexturedCube(0.8f, cube->lod);
+            glPopMatrix();
         }
     } else {
         // Draw single rotating cube
@@ -346,25 +1833,99 @@ void display() {
         glRotatef(rotationZ, 0.0f, 0.0f, 1.0f);
         
         glColor3f(1.0f, 1.0f, 1.0f);
-        drawTexturedCube(1.0f);
+        drawTexturedCube(1.0f, selectCubeLod(1.0f, viewDepth(0.0f, 0.0f, 0.0f)));
         glPopMatrix();
     }
     
+    if (useClusters) {
+        glUseProgram(0);
+        drawPointLights();
+    }
+    
+    if (recording) captureFrame();
     glutSwapBuffers();
+    
+    // The first frame in a new rendering mode is an event too: the driver
+    // builds the state and shader variants for it lazily
+    int renderMode = wireframeMode | (lightingEnabled << 1) | (useClusters << 2);
+    if (renderMode != lastRenderMode) {
+        unsigned long heapNow = heapAllocations;
+        modeAllocations += heapNow - heapBefore;
+        heapBefore = heapNow;
+        lastRenderMode = renderMode;
+    }
+    
+    // After warm-up the frame loop must not touch the heap or outgrow its arena
+    frameCount++;
+    if (frameCount > MEMCHECK_WARMUP_FRAMES &&
+        (heapAllocations != heapBefore || frameArena.overflows != overflowsBefore)) {
+        if (memoryViolations == 0) {
+            fprintf(stderr, "Warning: frame %lu allocated outside its budget\n", frameCount);
+        }
+        memoryViolations++;
+    }
 }
 
 // Animation update function
 void update(int value) {
+    if (recordOnStart) {
+        recordOnStart = 0;
+        // A scripted capture that cannot write anything would otherwise never exit
+        if (!startRecording()) {
+            shutdownTexture();
+            shutdownClusteredLighting();
+            exit(1);
+        }
+    }
+    if (recording && recordFrameLimit > 0 && recordFrameIndex >= (unsigned long) recordFrameLimit) {
+        stopRecording();
+        shutdownTexture();
+        shutdownClusteredLighting();
+        exit(0);
+    }
+    
+    if (memcheckFrames > 0) {
+        // Self test: step through the rendering modes once a second, then fail
+        // if any frame allocated. The bits of the phase cover every combination
+        // of clustered lighting, rounded meshes and wireframe within 8 seconds.
+        if (frameCount % 60 == 0) {
+            int phase = frameCount / 60;
+            showMultipleCubes = 1;
+            cubeGridRadius = 1 + phase % MAX_GRID_RADIUS;
+            currentTexture = (currentTexture + 1) % TEXTURE_COUNT;
+            switchTexture();
+            
+            clusteredLighting = clusterProgram && (phase & 1);
+            float roundness = (phase & 2) ? 0.25f : 0.0f;
+            if (roundness != cubeRoundness) {
+                cubeRoundness = roundness;
+                rebuildCubeMeshes();
+            }
+            wireframeMode = (phase & 4) != 0;
+            lodMode = phase % (LOD_LEVELS + 1) - 1; // Automatic, then each fixed level
+        }
+        if (frameCount >= (unsigned long) memcheckFrames) {
+            shutdownTexture();
+            printMemoryReport();
+            printf("Memory check %s\n", memoryViolations ? "FAILED" : "passed");
+            exit(memoryViolations ? 1 : 0);
+        }
+    }
+    
     if (isAnimating) {
         rotationX += rotationSpeed;
         rotationY += rotationSpeed * 0.7f;
         rotationZ += rotationSpeed * 0.3f;
+        lightOrbitAngle += rotationSpeed * 0.5f;
         
         if (rotationX > 360.0f) rotationX -= 360.0f;
         if (rotationY > 360.0f) rotationY -= 360.0f;
         if (rotationZ > 360.0f) rotationZ -= 360.0f;
+        if (lightOrbitAngle > 360.0f) lightOrbitAngle -= 360.0f;
         
         glutPostRedisplay();
+    } else if (textureStreamPending()) {
+        glutPostRedisplay(); // Keep presenting until the new texture is shown
     }
     glutTimerFunc(16, update, 0); // ~60 FPS
 }
@@ -373,6 +1934,10 @@ void update(int value) {
 void keyboard(unsigned char key, int x, int y) {
     switch (key) {
         case 27: // ESC key
+            stopRecording();
+            shutdownTexture();
+            shutdownClusteredLighting();
+            printMemoryReport();
             exit(0);
             break;
         case ' ': // Space - toggle animation
@@ -399,6 +1964,57 @@ void keyboard(unsigned char key, int x, int y) {
             printf("Multiple cubes mode %s\n", showMultipleCubes ? "enabled" : "disabled");
             glutPostRedisplay();
             break;
+        case 'g': // Grow the multiple cubes grid
+            cubeGridRadius = (cubeGridRadius >= MAX_GRID_RADIUS) ? 1 : cubeGridRadius * 2 + 1;
+            if (cubeGridRadius > MAX_GRID_RADIUS) cubeGridRadius = MAX_GRID_RADIUS;
+            printf("Cube grid: %dx%d\n", 2 * cubeGridRadius + 1, 2 * cubeGridRadius + 1);
+            glutPostRedisplay();
+            break;
+        case 'b': // Toggle rounded box edges
+            cubeRoundness = (cubeRoundness > 0.0f) ? 0.0f : 0.25f;
+            rebuildCubeMeshes();
+            printf("Rounded edges %s\n", cubeRoundness > 0.0f ? "enabled" : "disabled");
+            glutPostRedisplay();
+            break;
+        case 'k': // Cycle level of detail
+            lodMode = (lodMode + 2) % (LOD_LEVELS + 1) - 1;
+            if (lodMode < 0) {
+                printf("LOD: automatic\n");
+            } else {
+                printf("LOD: fixed level %d (%d quads per face)\n",
+                       lodMode, cubeMeshes[lodMode].segments * cubeMeshes[lodMode].segments);
+            }
+            glutPostRedisplay();
+            break;
+        case 'c': // Toggle clustered lighting
+            if (!clusterProgram) {
+                printf("Clustered lighting unavailable (needs buffer storage and GLSL 1.40)\n");
+                break;
+            }
+            clusteredLighting = !clusteredLighting;
+            printf("Clustered lighting %s (%d point lights)\n",
+                   clusteredLighting ? "enabled" : "disabled", pointLights.count);
+            glutPostRedisplay();
+            break;
+        case '[': // Fewer point lights
+        case ']': // More point lights
+            pointLights.count = (key == ']') ? pointLights.count * 2 : pointLights.count / 2;
+            if (pointLights.count < 1) pointLights.count = 1;
+            if (pointLights.count > MAX_POINT_LIGHTS) pointLights.count = MAX_POINT_LIGHTS;
+            printf("Point lights: %d (%d dropped from full clusters last frame)\n",
+                   pointLights.count, clusterOverflows);
+            glutPostRedisplay();
+            break;
+        case 'v': // Toggle recording
+            if (recording) {
+                stopRecording();
+            } else {
+                startRecording();
+            }
+            break;
+        case 'p': // Print memory report
+            printMemoryReport();
+            break;
         case '+': // Increase rotation speed
             rotationSpeed += 0.5f;
             printf("Rotation speed: %.1f\n", rotationSpeed);
@@ -448,6 +2064,12 @@ void specialKeys(int key, int x, int y) {
 void reshape(int width, int height) {
     if (height == 0) height = 1;
     
+    // Recordings keep one frame size
+    if (recording && ((width & ~1) != recordWidth || (height & ~1) != recordHeight)) {
+        printf("Window resized, stopping recording\n");
+        stopRecording();
+    }
+    
     windowWidth = width;
     windowHeight = height;
     
@@ -455,7 +2077,7 @@ void reshape(int width, int height) {
     
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluPerspective(45.0f, (float)width / height, 0.1f, 100.0f);
+    gluPerspective(FIELD_OF_VIEW, (float)width / height, NEAR_PLANE, FAR_PLANE);
     
     glMatrixMode(GL_MODELVIEW);
     printf("Window resized to %dx%d\n", width, height);
@@ -470,6 +2092,13 @@ void printInstructions() {
     printf("W         - Toggle wireframe mode\n");
     printf("L         - Toggle lighting\n");
     printf("M         - Toggle multiple cubes mode\n");
+    printf("G         - Grow cube grid (3x3 up to 21x21)\n");
+    printf("B         - Toggle rounded box edges\n");
+    printf("K         - Cycle level of detail (auto / fixed)\n");
+    printf("C         - Toggle clustered lighting\n");
+    printf("[/]       - Halve/double point light count\n");
+    printf("V         - Start/stop recording\n");
+    printf("P         - Print memory report\n");
     printf("+/-       - Increase/decrease rotation speed\n");
     printf("R         - Reset view\n");
     printf("Arrow Keys - Rotate camera\n");
@@ -483,6 +2112,7 @@ void initGL() {
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_TEXTURE_2D);
     glShadeModel(GL_SMOOTH);
+    glEnable(GL_NORMALIZE); // Meshes are unit sized and scaled per cube
     
     // Enable alpha blending for transparency effects
     glEnable(GL_BLEND);
@@ -493,17 +2123,47 @@ void initGL() {
 
 // Main function
 int main(int argc, char** argv) {
+    // Benchmarks that need no window run before GLUT opens a display
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--light-bench") == 0) {
+            runLightBenchmark();
+            return 0;
+        }
+    }
+    
     printf("Enhanced 3D Textured Cube Demo Starting...\n");
     
     glutInit(&argc, argv);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--memcheck") == 0) {
+            memcheckFrames = 600;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                memcheckFrames = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--record") == 0) {
+            recordOnStart = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-') recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--record-pipe") == 0 && i + 1 < argc) {
+            recordOnStart = 1;
+            recordPipe = argv[++i];
+        } else if (strcmp(argv[i], "--record-frames") == 0 && i + 1 < argc) {
+            recordFrameLimit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &windowWidth, &windowHeight);
+        }
+    }
+    
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(windowWidth, windowHeight);
     glutInitWindowPosition(100, 100);
     glutCreateWindow("Enhanced 3D Textured Cube with Multiple Effects");
     
     initGL();
+    arenaInit(&frameArena, FRAME_ARENA_SIZE);
     initTexture();
+    initCubeMeshes();
     initLighting();
+    initClusteredLighting();
     
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);